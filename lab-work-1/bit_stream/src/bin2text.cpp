@@ -18,6 +18,8 @@
 //
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <string>
 #include "bit_stream.h"
 
 using namespace std;
@@ -27,39 +29,52 @@ using namespace std;
 int main(int argc, char* argv[]) {
 
 	if(argc < 3) {
-		cerr << "Usage: bin2text bin_file text_file\n";
+		cerr << "Usage: bin2text [ -mmap ] bin_file text_file\n";
 		return 1;
 	}
 
-	fstream ifs { argv[argc-2], ios::in | ios::binary };
-	if(not ifs.is_open()) {
-		cerr << "Error opening text file " << argv[argc-2] << endl;
+	bool use_mmap = false;
+	for(int n = 1 ; n < argc-2 ; n++)
+		if(string(argv[n]) == "-mmap")
+			use_mmap = true;
+
+	fstream ifs;
+	unique_ptr<BitStream> ibs;
+	if(use_mmap) // Read the bin file straight from the page cache
+		ibs = make_unique<BitStream>(argv[argc-2], STREAM_READ);
+
+	else {
+		ifs.open(argv[argc-2], ios::in | ios::binary);
+		ibs = make_unique<BitStream>(ifs, STREAM_READ);
+	}
+
+	if(not ibs->is_open()) {
+		cerr << "Error opening bin file " << argv[argc-2] << endl;
 		return 1;
 	}
 
 	fstream ofs { argv[argc-1], ios::out | ios::binary };
 	if(not ofs.is_open()) {
-		cerr << "Error opening bin file " << argv[argc-1] << endl;
+		cerr << "Error opening text file " << argv[argc-1] << endl;
 		return 1;
 	}
 
-	BitStream ibs { ifs, STREAM_READ };
+	// The text is written in large chunks, not one digit at a time
+	string text;
+	text.reserve(BYTE_STREAM_BUF_SIZE);
 
 	int c;
-	while((c = ibs.read_bit()) != EOF) {
-		switch(c) {
-			case 0:
-				ofs << "0";
-				break;
-			case 1:
-				ofs << "1";
-				break;
+	while((c = ibs->read_bit()) != EOF) {
+		text += c == 0 ? '0' : '1';
+		if(text.size() == BYTE_STREAM_BUF_SIZE) {
+			ofs.write(text.data(), text.size());
+			text.clear();
 		}
 	}
 
-	ofs << "\n";
+	text += '\n';
+	ofs.write(text.data(), text.size());
 	ofs.close();
 
 	return 0;
 }
-
@@ -0,0 +1,49 @@
+#include <cstddef>
+#include <cstdint>
+#include "bit_buffer.h"
+
+using namespace std;
+
+void BitBuffer::write_bit(int bit) {
+	write_n_bits(bit & 0x01, 1);
+}
+
+void BitBuffer::write_n_bits(uint64_t bits, int n) {
+	if(n <= 0)
+		return;
+
+	if(n < 64)
+		bits &= (static_cast<uint64_t>(1) << n) - 1;
+
+	int n_free = 64 - m_acc_bits;
+	if(n < n_free) {
+		m_acc |= bits << (n_free - n);
+		m_acc_bits += n;
+		return;
+	}
+
+	// The accumulator becomes full: store it and keep the remaining bits
+	int n_left = n - n_free;
+	m_words.push_back(m_acc | (bits >> n_left));
+	m_acc = n_left == 0 ? 0 : bits << (64 - n_left);
+	m_acc_bits = n_left;
+}
+
+size_t BitBuffer::size() const {
+	return (m_words.size() << 6) + m_acc_bits;
+}
+
+void BitBuffer::clear() {
+	m_words.clear();
+	m_acc = 0;
+	m_acc_bits = 0;
+}
+
+void BitBuffer::write_to(BitStream& bs) const {
+	for(const uint64_t word : m_words)
+		bs.write_n_bits(word, 64);
+
+	if(m_acc_bits != 0)
+		bs.write_n_bits(m_acc >> (64 - m_acc_bits), m_acc_bits);
+}
+
@@ -0,0 +1,27 @@
+#ifndef BIT_BUFFER_H
+#define BIT_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "bit_stream.h"
+
+// In-memory bit sink with the same writing interface as BitStream, so that
+// blocks can be coded independently (e.g. by worker threads) and later
+// appended, in order, to a BitStream.
+class BitBuffer {
+  private:
+	std::vector<uint64_t>	m_words;
+	uint64_t				m_acc { };
+	int						m_acc_bits { };
+
+  public:
+	void write_bit(int bit);
+	void write_n_bits(uint64_t bits, int n);
+	size_t size() const; // In bits
+	void clear();
+	void write_to(BitStream& bs) const;
+};
+
+#endif
+
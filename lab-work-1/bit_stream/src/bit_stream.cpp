@@ -16,45 +16,132 @@
 //
 //-------------------------------------------------------------------------------------------
 
+#include <bit>
 #include <cstdint>
 #include <fstream>
+#include <stdexcept>
 #include <string>
 #include "bit_stream.h"
 
 using namespace std;
 
+static uint64_t load_be64(const uint8_t* bytes) {
+	uint64_t x { };
+	for(int i = 0 ; i < 8 ; i++)
+		x = (x << 8) | bytes[i];
+
+	return x;
+}
+
+static void store_be64(uint8_t* bytes, uint64_t x) {
+	for(int i = 7 ; i >= 0 ; i--) {
+		bytes[i] = x & 0xff;
+		x >>= 8;
+	}
+}
+
 BitStream::BitStream(fstream& fs, bool rw_status) : m_rw_status { rw_status },
   m_byte_stream { fs, rw_status } {
-	if(rw_status) {
-		m_bit_ptr = -1;
-	} else {
-		m_bit_ptr = 7;
-		m_buf = 0;
-	}
+}
+
+BitStream::BitStream(const string& path, bool rw_status) : m_rw_status { rw_status },
+  m_byte_stream { path, rw_status } {
+}
+
+//-------------------------------------------------------------------------------------------
+//
+// Tops up the accumulator with as many whole bytes as fit. Afterwards at
+// least 57 bits are available, unless the end of the file was reached.
+//
+void BitStream::refill() {
+	uint8_t bytes[8] { };
+	size_t n_bytes = m_byte_stream.get_bytes(bytes, (64 - m_acc_bits) >> 3);
+
+	m_acc |= load_be64(bytes) >> m_acc_bits;
+	m_acc_bits += n_bytes << 3;
+}
+
+//-------------------------------------------------------------------------------------------
+//
+// Moves all the complete bytes of the accumulator to the byte stream,
+// leaving at most 7 bits behind
+//
+void BitStream::spill() {
+	uint8_t bytes[8];
+	int n_bytes = m_acc_bits >> 3;
+
+	store_be64(bytes, m_acc);
+	m_byte_stream.put_bytes(bytes, n_bytes);
+	m_acc = n_bytes == 8 ? 0 : m_acc << (n_bytes << 3);
+	m_acc_bits -= n_bytes << 3;
 }
 
 int BitStream::read_bit() {
-	if(--m_bit_ptr < 0) {
-		if((m_buf = m_byte_stream.get()) == EOF)
+	if(m_acc_bits == 0) {
+		refill();
+		if(m_acc_bits == 0)
 			return EOF;
-
-		m_bit_ptr = 7;
 	}
 
-	return (m_buf & (0x01 << m_bit_ptr)) >> m_bit_ptr;
+	int bit = m_acc >> 63;
+	m_acc <<= 1;
+	m_acc_bits--;
+
+	return bit;
 }
 
 uint64_t BitStream::read_n_bits(int n) {
-    uint64_t x { };
-    for(int i = n - 1; i >= 0; --i) {
-        int bit = read_bit();
-        if (bit == EOF) {
-            // Handle EOF properly
-            throw std::runtime_error("Reached EOF while reading bits");
-        }
-        x |= (static_cast<uint64_t>(bit) << i);
-    }
-    return x;
+	if(n > 57) { // Too wide for a single refill: read it in two parts
+		uint64_t x = read_n_bits(n - 32);
+		return (x << 32) | read_n_bits(32);
+	}
+
+	if(n <= 0)
+		return 0;
+
+	if(m_acc_bits < n) {
+		refill();
+		if(m_acc_bits < n)
+			throw runtime_error("Reached EOF while reading bits");
+	}
+
+	uint64_t x = m_acc >> (64 - n);
+	m_acc <<= n;
+	m_acc_bits -= n;
+
+	return x;
+}
+
+//-------------------------------------------------------------------------------------------
+//
+// Counts consecutive 1 bits, up to "max", and also consumes the terminating
+// 0 bit when it is found before reaching "max"
+//
+int BitStream::read_unary(int max) {
+	int count = 0;
+
+	while(count < max) {
+		if(m_acc_bits == 0) {
+			refill();
+			if(m_acc_bits == 0)
+				throw runtime_error("Reached EOF while reading bits");
+		}
+
+		// The unused low bits of the accumulator are 0, so this never exceeds m_acc_bits
+		int n_ones = countl_zero(~m_acc);
+		if(n_ones > max - count)
+			n_ones = max - count;
+
+		count += n_ones;
+		int n_consumed = (count < max && n_ones < m_acc_bits) ? n_ones + 1 : n_ones;
+		m_acc = n_consumed == 64 ? 0 : m_acc << n_consumed;
+		m_acc_bits -= n_consumed;
+
+		if(n_consumed > n_ones)
+			break;
+	}
+
+	return count;
 }
 
 string BitStream::read_string() {
@@ -68,18 +155,28 @@ string BitStream::read_string() {
 }
 
 void BitStream::write_bit(int bit) {
-	if(m_bit_ptr < 0) {
-		m_byte_stream.put(m_buf);
-		m_bit_ptr = 7;
-		m_buf = 0;
-	}
+	if(m_acc_bits == 64)
+		spill();
 
-	m_buf |= (bit & 0x01) << m_bit_ptr--;
+	m_acc |= static_cast<uint64_t>(bit & 0x01) << (63 - m_acc_bits++);
 }
 
 void BitStream::write_n_bits(uint64_t bits, int n) {
-	for(int i = n - 1 ; i >= 0 ; i--)
-		write_bit(((0x01 << i) & bits) >> i);
+	if(n > 57) { // Too wide to fit after a spill: write it in two parts
+		write_n_bits(bits >> 32, n - 32);
+		write_n_bits(bits, 32);
+		return;
+	}
+
+	if(n <= 0)
+		return;
+
+	if(m_acc_bits + n > 64)
+		spill();
+
+	bits &= (static_cast<uint64_t>(1) << n) - 1;
+	m_acc |= bits << (64 - m_acc_bits - n);
+	m_acc_bits += n;
 }
 
 void BitStream::write_string(const string& s) {
@@ -90,13 +187,36 @@ void BitStream::write_string(const string& s) {
 }
 
 off_t BitStream::tell() {
-	return m_byte_stream.tell();
+	// Only bytes that were (at least partially) consumed or completely written count
+	if(m_rw_status)
+		return m_byte_stream.tell() - (m_acc_bits >> 3);
+
+	return m_byte_stream.tell() + (m_acc_bits >> 3);
+}
+
+uint64_t BitStream::tell_bits() {
+	if(m_rw_status)
+		return (static_cast<uint64_t>(m_byte_stream.tell()) << 3) - m_acc_bits;
+
+	return (static_cast<uint64_t>(m_byte_stream.tell()) << 3) + m_acc_bits;
+}
+
+void BitStream::seek_bits(uint64_t pos) { // Only for reading
+	m_byte_stream.seek(pos >> 3);
+	m_acc = 0;
+	m_acc_bits = 0;
+	read_n_bits(pos & 0x07);
+}
+
+bool BitStream::is_open() const {
+	return m_byte_stream.is_open();
 }
 
 void BitStream::close() {
 	if(not m_rw_status) {
-		if(m_bit_ptr != 7) // Flush the bit buffer only if there are some bits there
-			m_byte_stream.put(m_buf);
+		spill();
+		if(m_acc_bits != 0) // Flush the last, incomplete, byte padded with zeros
+			m_byte_stream.put(m_acc >> 56);
 	}
 
 	m_byte_stream.close(); // Calls byte_stream flush if needed
@@ -19,19 +19,27 @@
 #ifndef BIT_STREAM_H
 #define BIT_STREAM_H
 
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include "byte_stream.h"
 
+// Bits are kept MSB-first in a 64-bit accumulator, which is refilled
+// from (or spilled to) the byte stream in whole bytes, so that reads and
+// writes of up to 57 bits are a single shift-and-mask.
 class BitStream {
   private:
 	bool		m_rw_status { STREAM_READ };
-	int			m_buf;
-	int			m_bit_ptr;
+	uint64_t	m_acc { };
+	int			m_acc_bits { };
 	ByteStream	m_byte_stream;
 
+	void refill();
+	void spill();
+
   public:
 	BitStream(std::fstream& fs, bool rw_status);
+	BitStream(const std::string& path, bool rw_status); // Memory-mapped backend
 
 	BitStream() = delete;
 	BitStream(const BitStream&) = delete;
@@ -41,11 +49,15 @@ class BitStream {
 
 	int read_bit();
 	uint64_t read_n_bits(int n);
+	int read_unary(int max);
 	std::string read_string();
 	void write_bit(int bit);
 	void write_n_bits(uint64_t bits, int n);
 	void write_string(const std::string& s);
 	off_t tell();
+	uint64_t tell_bits();
+	void seek_bits(uint64_t pos);
+	bool is_open() const;
 	void close();
 };
 
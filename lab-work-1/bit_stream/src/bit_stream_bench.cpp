@@ -0,0 +1,177 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "bit_stream.h"
+
+using namespace std;
+
+//------------------------------------------------------------------------------
+//
+// The previous bit-at-a-time BitStream, kept as the reference for both the
+// file format and the speed comparison
+//
+class LegacyBitStream {
+  private:
+	bool		m_rw_status { STREAM_READ };
+	int			m_buf;
+	int			m_bit_ptr;
+	ByteStream	m_byte_stream;
+
+  public:
+	LegacyBitStream(fstream& fs, bool rw_status) : m_rw_status { rw_status },
+	  m_byte_stream { fs, rw_status } {
+		if(rw_status) {
+			m_bit_ptr = -1;
+		} else {
+			m_bit_ptr = 7;
+			m_buf = 0;
+		}
+	}
+
+	int read_bit() {
+		if(--m_bit_ptr < 0) {
+			if((m_buf = m_byte_stream.get()) == EOF)
+				return EOF;
+
+			m_bit_ptr = 7;
+		}
+
+		return (m_buf & (0x01 << m_bit_ptr)) >> m_bit_ptr;
+	}
+
+	uint64_t read_n_bits(int n) {
+		uint64_t x { };
+		for(int i = n - 1 ; i >= 0 ; --i) {
+			int bit = read_bit();
+			if(bit == EOF)
+				throw runtime_error("Reached EOF while reading bits");
+
+			x |= (static_cast<uint64_t>(bit) << i);
+		}
+
+		return x;
+	}
+
+	void write_bit(int bit) {
+		if(m_bit_ptr < 0) {
+			m_byte_stream.put(m_buf);
+			m_bit_ptr = 7;
+			m_buf = 0;
+		}
+
+		m_buf |= (bit & 0x01) << m_bit_ptr--;
+	}
+
+	// Shifts the 64-bit value, so that widths above 31 bits also work
+	void write_n_bits(uint64_t bits, int n) {
+		for(int i = n - 1 ; i >= 0 ; i--)
+			write_bit((bits >> i) & 0x01);
+	}
+
+	void close() {
+		if(not m_rw_status) {
+			if(m_bit_ptr != 7)
+				m_byte_stream.put(m_buf);
+		}
+
+		m_byte_stream.close();
+	}
+};
+
+//------------------------------------------------------------------------------
+
+struct Timing {
+	double write_s;
+	double read_s;
+};
+
+template <typename Stream>
+Timing run(const string& fileName, const vector<uint64_t>& values, const vector<int>& widths) {
+	Timing t { };
+
+	fstream ofs { fileName, ios::out | ios::binary };
+	auto start = chrono::steady_clock::now();
+	{
+		Stream obs { ofs, STREAM_WRITE };
+		for(size_t i = 0 ; i < values.size() ; i++)
+			obs.write_n_bits(values[i], widths[i]);
+
+		obs.close();
+	}
+	t.write_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	fstream ifs { fileName, ios::in | ios::binary };
+	start = chrono::steady_clock::now();
+	{
+		Stream ibs { ifs, STREAM_READ };
+		for(size_t i = 0 ; i < values.size() ; i++)
+			if(ibs.read_n_bits(widths[i]) != values[i])
+				throw runtime_error("Value mismatch when reading back " + fileName);
+	}
+	t.read_s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	return t;
+}
+
+static bool same_contents(const string& a, const string& b) {
+	ifstream fa { a, ios::binary }, fb { b, ios::binary };
+	return vector<char>(istreambuf_iterator<char>(fa), {}) ==
+	  vector<char>(istreambuf_iterator<char>(fb), {});
+}
+
+int main(int argc, char* argv[]) {
+
+	size_t nValues { 10000000 };
+	int width { 0 };
+
+	for(int n = 1 ; n < argc ; n++)
+		if(string(argv[n]) == "-n" && n + 1 < argc)
+			nValues = stoul(argv[n+1]);
+
+	for(int n = 1 ; n < argc ; n++)
+		if(string(argv[n]) == "-w" && n + 1 < argc)
+			width = stoi(argv[n+1]);
+
+	if(width < 0 || width > 64) {
+		cerr << "Usage: bit_stream_bench [ -n numValues (def 10000000) ]\n";
+		cerr << "                        [ -w width 1..64 (def random 1..32) ]\n";
+		return 1;
+	}
+
+	mt19937_64 rng { 12345 };
+	uniform_int_distribution<int> widthDist { 1, 32 };
+	vector<uint64_t> values(nValues);
+	vector<int> widths(nValues);
+	size_t totalBits { };
+	for(size_t i = 0 ; i < nValues ; i++) {
+		widths[i] = width ? width : widthDist(rng);
+		values[i] = widths[i] == 64 ? rng() : rng() & ((static_cast<uint64_t>(1) << widths[i]) - 1);
+		totalBits += widths[i];
+	}
+
+	const string newFile { "bit_stream_bench.new" };
+	const string legacyFile { "bit_stream_bench.legacy" };
+	Timing legacy = run<LegacyBitStream>(legacyFile, values, widths);
+	Timing current = run<BitStream>(newFile, values, widths);
+	bool identical = same_contents(newFile, legacyFile);
+	remove(newFile.c_str());
+	remove(legacyFile.c_str());
+
+	cout << "Values: " << nValues << ", bits: " << totalBits << "\n";
+	cout.setf(ios::fixed);
+	cout.precision(1);
+	cout << "Legacy  write: " << totalBits / legacy.write_s / 1e6 << " Mbit/s, read: "
+	  << totalBits / legacy.read_s / 1e6 << " Mbit/s\n";
+	cout << "Current write: " << totalBits / current.write_s / 1e6 << " Mbit/s, read: "
+	  << totalBits / current.read_s / 1e6 << " Mbit/s\n";
+	cout << "Speedup write: " << legacy.write_s / current.write_s << "x, read: "
+	  << legacy.read_s / current.read_s << "x\n";
+	cout << "Output files are " << (identical ? "identical" : "DIFFERENT") << "\n";
+
+	return identical ? 0 : 1;
+}
@@ -16,21 +16,123 @@
 //
 //-------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "byte_stream.h"
 
 using namespace std;
 
 //-------------------------------------------------------------------------------------------
 
-ByteStream::ByteStream(fstream& fs, bool rw_status) : m_rw_status { rw_status }, m_fs { fs } {
-	m_buf_limit = m_buf + BYTE_STREAM_BUF_SIZE;
+ByteStream::ByteStream(fstream& fs, bool rw_status) : m_rw_status { rw_status }, m_fs { &fs } {
+	m_buf_start = m_buf;
+	if(m_rw_status) // Open for reading: the buffer starts empty
+		m_buf_ptr = m_buf_limit = m_buf;
+
+	else { // Open for writing
+		m_buf_ptr = m_buf;
+		m_buf_limit = m_buf + BYTE_STREAM_BUF_SIZE;
+	}
+}
+
+//-------------------------------------------------------------------------------------------
+//
+// Mapped backend: when reading, the buffer is the whole file, mapped in
+// memory; when writing, it is a large batch that is written with pwrite()
+//
+ByteStream::ByteStream(const string& path, bool rw_status) : m_rw_status { rw_status } {
 	if(m_rw_status) { // Open for reading
-		m_buf_ptr = m_buf_limit;
-		m_size = BYTE_STREAM_BUF_SIZE;
+		m_fd = ::open(path.c_str(), O_RDONLY);
+
+		struct stat st;
+		if(m_fd >= 0 and fstat(m_fd, &st) == 0 and st.st_size > 0) { // An empty file cannot be mapped
+			void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+			if(map == MAP_FAILED)
+				release();
+
+			else {
+				m_map = static_cast<uint8_t*>(map);
+				m_map_size = st.st_size;
+				madvise(m_map, m_map_size, MADV_SEQUENTIAL);
+			}
+		}
+
+		m_buf_start = m_buf_ptr = m_map;
+		m_buf_limit = m_map + m_map_size;
 	}
 
-	else // Open for writing
-		m_buf_ptr = m_buf;
+	else { // Open for writing
+		m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		m_batch = make_unique<uint8_t[]>(BYTE_STREAM_WRITE_BATCH_SIZE);
+		m_buf_start = m_buf_ptr = m_batch.get();
+		m_buf_limit = m_buf_start + BYTE_STREAM_WRITE_BATCH_SIZE;
+	}
+}
+
+ByteStream::~ByteStream() {
+	release();
+}
+
+//---------------------------------------------------------------------------------
+//
+// Unmaps and closes the file of the mapped backend
+//
+void ByteStream::release() {
+	if(m_map != nullptr) {
+		munmap(m_map, m_map_size);
+		m_map = nullptr;
+	}
+
+	if(m_fd >= 0) {
+		::close(m_fd);
+		m_fd = -1;
+	}
+}
+
+//---------------------------------------------------------------------------------
+//
+// Gets the next block of the file into the buffer. Returns false at the end
+// of the file (the mapped backend always has the whole file in the buffer).
+//
+bool ByteStream::fill() {
+	if(m_fs == nullptr)
+		return false;
+
+	m_fs->read((char*)m_buf, BYTE_STREAM_BUF_SIZE);
+	m_buf_ptr = m_buf;
+	m_buf_limit = m_buf + m_fs->gcount();
+
+	return m_buf_limit != m_buf;
+}
+
+//---------------------------------------------------------------------------------
+//
+// Writes the buffer contents, which end at the file position m_tell
+//
+void ByteStream::write_buf() {
+	size_t n_bytes = m_buf_ptr - m_buf_start;
+
+	if(m_fs != nullptr)
+		m_fs->write((char*)m_buf_start, n_bytes);
+
+	else {
+		off_t pos = m_tell - n_bytes;
+		for(uint8_t* p = m_buf_start ; p != m_buf_ptr ; ) {
+			ssize_t n = pwrite(m_fd, p, m_buf_ptr - p, pos);
+			if(n <= 0)
+				throw runtime_error("Error writing to file");
+
+			p += n;
+			pos += n;
+		}
+	}
+
+	m_buf_ptr = m_buf_start;
 }
 
 //---------------------------------------------------------------------------------
@@ -41,10 +143,8 @@ void ByteStream::put(int c) {
 	*m_buf_ptr++ = c;
 	m_tell++;
 
-	if(m_buf_ptr == m_buf_limit) { // buffer is full: write it
-		m_fs.write((char*)m_buf, BYTE_STREAM_BUF_SIZE);
-		m_buf_ptr = m_buf;
-	}
+	if(m_buf_ptr == m_buf_limit) // buffer is full: write it
+		write_buf();
 }
 
 //---------------------------------------------------------------------------------
@@ -52,16 +152,8 @@ void ByteStream::put(int c) {
 // m_buf_ptr points to the next buffer char
 //
 int ByteStream::get() {
-	if(m_buf_ptr == m_buf_limit) { // buffer is empty: get another block
-		m_fs.read((char*)m_buf, BYTE_STREAM_BUF_SIZE);
-		if((m_size = m_fs.gcount()) == 0)
-			return EOF;
-
-		m_buf_ptr = m_buf;
-	} else {
-		if(m_buf_ptr - m_buf == m_size)
-			return EOF;
-	}
+	if(m_buf_ptr == m_buf_limit and not fill()) // buffer is empty: get another block
+		return EOF;
 
 	m_tell++;
 	return *m_buf_ptr++;
@@ -69,15 +161,51 @@ int ByteStream::get() {
 
 //---------------------------------------------------------------------------------
 //
-// m_buf_ptr points to a free buffer position
+// Bulk version of put(): copies whole runs of bytes into the buffer
 //
-void ByteStream::flush() {
-	size_t n_bytes_to_write = m_buf_ptr - m_buf;
+void ByteStream::put_bytes(const uint8_t* src, size_t n) {
+	while(n != 0) {
+		size_t n_bytes = min(n, static_cast<size_t>(m_buf_limit - m_buf_ptr));
+		memcpy(m_buf_ptr, src, n_bytes);
+		m_buf_ptr += n_bytes;
+		m_tell += n_bytes;
+		src += n_bytes;
+		n -= n_bytes;
+
+		if(m_buf_ptr == m_buf_limit) // buffer is full: write it
+			write_buf();
+	}
+}
 
-	if(n_bytes_to_write != 0) { // If buf is not empty
-		m_fs.write((char*)m_buf, n_bytes_to_write);
-		m_buf_ptr = m_buf;
+//---------------------------------------------------------------------------------
+//
+// Bulk version of get(): returns the number of bytes copied, which is
+// smaller than n only when the end of the file is reached
+//
+size_t ByteStream::get_bytes(uint8_t* dst, size_t n) {
+	size_t n_read = 0;
+
+	while(n_read < n) {
+		if(m_buf_ptr == m_buf_limit and not fill()) // buffer is empty: get another block
+			break;
+
+		size_t n_bytes = min(n - n_read, static_cast<size_t>(m_buf_limit - m_buf_ptr));
+		memcpy(dst + n_read, m_buf_ptr, n_bytes);
+		m_buf_ptr += n_bytes;
+		n_read += n_bytes;
 	}
+
+	m_tell += n_read;
+	return n_read;
+}
+
+//---------------------------------------------------------------------------------
+//
+// m_buf_ptr points to a free buffer position
+//
+void ByteStream::flush() {
+	if(m_buf_ptr != m_buf_start) // If buf is not empty
+		write_buf();
 }
 
 //---------------------------------------------------------------------------------
@@ -86,13 +214,40 @@ off_t ByteStream::tell() {
 	return m_tell;
 }
 
+//---------------------------------------------------------------------------------
+//
+// Only for reading: discards the buffer and continues at byte "pos"
+//
+void ByteStream::seek(off_t pos) {
+	if(m_fs == nullptr) // Mapped: just move inside the buffer
+		m_buf_ptr = m_map + min(static_cast<size_t>(pos), m_map_size);
+
+	else {
+		m_fs->clear();
+		m_fs->seekg(pos);
+		m_buf_ptr = m_buf_limit = m_buf;
+	}
+
+	m_tell = pos;
+}
+
+//---------------------------------------------------------------------------------
+
+bool ByteStream::is_open() const {
+	return m_fs != nullptr ? m_fs->is_open() : m_fd >= 0;
+}
+
 //---------------------------------------------------------------------------------
 
 void ByteStream::close() {
 	if(not m_rw_status)
 		this->flush();
 
-	m_fs.close();
+	if(m_fs != nullptr)
+		m_fs->close();
+
+	else
+		release();
 }
 
 //---------------------------------------------------------------------------------
@@ -21,23 +21,42 @@
 
 #include <fstream>
 #include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
 
 const int BYTE_STREAM_BUF_SIZE = 65536;
+const size_t BYTE_STREAM_WRITE_BATCH_SIZE = 1 << 20; // pwrite() batch of the mapped backend
 const bool STREAM_READ = true;
 const bool STREAM_WRITE = false;
 
+// Two backends with the same interface: an std::fstream copied through m_buf,
+// or a file opened by path, which is mmap()ed for reading (get() reads the
+// page cache directly) and written in large pwrite() batches.
 class ByteStream {
   private:
 	uint8_t			m_buf[BYTE_STREAM_BUF_SIZE];
+	uint8_t*		m_buf_start;
 	uint8_t*		m_buf_ptr;
 	uint8_t*		m_buf_limit;
-	int				m_size;
 	bool			m_rw_status { STREAM_READ };
 	off_t			m_tell { };
-	std::fstream&	m_fs;
+	std::fstream*	m_fs { };
+
+	// Mapped backend
+	int							m_fd { -1 };
+	uint8_t*					m_map { };
+	size_t						m_map_size { };
+	std::unique_ptr<uint8_t[]>	m_batch;
+
+	bool fill();
+	void write_buf();
+	void release();
 
   public:
 	ByteStream(std::fstream& fs, bool rw_status);
+	ByteStream(const std::string& path, bool rw_status);
+	~ByteStream();
 
 	ByteStream() = delete;
 	ByteStream(const ByteStream&) = delete;
@@ -47,8 +66,12 @@ class ByteStream {
 
 	void put(int c);
 	int get();
+	void put_bytes(const uint8_t* src, size_t n);
+	size_t get_bytes(uint8_t* dst, size_t n);
 	void flush();
 	off_t tell();
+	void seek(off_t pos);
+	bool is_open() const;
 	void close();
 };
 
@@ -0,0 +1,111 @@
+#include "fast_dct.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Somas diretas O(N^2) usadas anteriormente em dct_codec.cpp (referência)
+void directDCT(const std::vector<double>& input, std::vector<double>& output) {
+    const std::size_t size = input.size();
+    const double sizeAsDouble = static_cast<double>(size);
+
+    for (std::size_t k = 0; k < size; ++k) {
+        double sum = 0.0;
+        const double scale = (k == 0) ? 1.0 / std::sqrt(sizeAsDouble) : std::sqrt(2.0 / sizeAsDouble);
+
+        for (std::size_t n = 0; n < size; ++n) {
+            const double angleNumerator = PI * (2.0 * static_cast<double>(n) + 1.0) * static_cast<double>(k);
+            sum += input[n] * std::cos(angleNumerator / (2.0 * sizeAsDouble));
+        }
+
+        output[k] = scale * sum;
+    }
+}
+
+void directIDCT(const std::vector<double>& input, std::vector<double>& output) {
+    const std::size_t size = input.size();
+    const double sizeAsDouble = static_cast<double>(size);
+    const double dcScale = 1.0 / std::sqrt(sizeAsDouble);
+    const double acScale = std::sqrt(2.0 / sizeAsDouble);
+
+    for (std::size_t n = 0; n < size; ++n) {
+        double sum = input[0] * dcScale;
+
+        for (std::size_t k = 1; k < size; ++k) {
+            const double angleNumerator = PI * (2.0 * static_cast<double>(n) + 1.0) * static_cast<double>(k);
+            sum += acScale * input[k] * std::cos(angleNumerator / (2.0 * sizeAsDouble));
+        }
+
+        output[n] = sum;
+    }
+}
+
+double maxAbsDifference(const std::vector<double>& a, const std::vector<double>& b) {
+    double difference = 0.0;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        difference = std::max(difference, std::abs(a[i] - b[i]));
+    }
+    return difference;
+}
+
+template <typename Function>
+double microsecondsPerCall(std::size_t iterations, Function function) {
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        function();
+    }
+    const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / static_cast<double>(iterations);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    std::size_t blockSize = 1024;
+    std::size_t iterations = 20;
+
+    for (int n = 1; n + 1 < argc; ++n) {
+        if (std::string(argv[n]) == "-bs") {
+            blockSize = std::stoul(argv[n + 1]);
+        } else if (std::string(argv[n]) == "-n") {
+            iterations = std::stoul(argv[n + 1]);
+        }
+    }
+
+    std::vector<double> block(blockSize);
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> sample(-32768.0, 32767.0);
+    for (auto& x : block) {
+        x = sample(rng);
+    }
+
+    FastDCT dct(blockSize);
+    std::vector<double> directCoefficients(blockSize), fastCoefficients(blockSize);
+    std::vector<double> directSamples(blockSize), fastSamples(blockSize);
+
+    const double directForward = microsecondsPerCall(iterations, [&] { directDCT(block, directCoefficients); });
+    const double directInverse = microsecondsPerCall(iterations, [&] { directIDCT(directCoefficients, directSamples); });
+    const std::size_t fastIterations = iterations * 100;
+    const double fastForward = microsecondsPerCall(fastIterations, [&] { dct.forward(block, fastCoefficients); });
+    const double fastInverse = microsecondsPerCall(fastIterations, [&] { dct.inverse(fastCoefficients, fastSamples); });
+
+    std::cout << "Tamanho do bloco: " << blockSize << "\n";
+    std::cout << "DCT direta:  " << directForward << " us/bloco, IDCT direta:  " << directInverse << " us/bloco\n";
+    std::cout << "DCT rápida:  " << fastForward << " us/bloco, IDCT rápida:  " << fastInverse << " us/bloco\n";
+    std::cout << "Aceleração:  " << directForward / fastForward << "x (DCT), "
+              << directInverse / fastInverse << "x (IDCT)\n";
+    std::cout << "Diferença máxima dos coeficientes: " << maxAbsDifference(directCoefficients, fastCoefficients) << "\n";
+    std::cout << "Diferença máxima das amostras:     " << maxAbsDifference(directSamples, fastSamples) << "\n";
+    std::cout << "Erro máximo de reconstrução:       " << maxAbsDifference(block, fastSamples) << "\n";
+
+    return 0;
+}
@@ -2,56 +2,200 @@
 
 #include <sndfile.hh>
 
+#include "bit_buffer.h"
 #include "bit_stream.h"
+#include "fast_dct.h"
 #include "quantization.h"
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <bit>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
-constexpr std::size_t BLOCK_SIZE = 1024;
-constexpr double PI = 3.14159265358979323846;
+// Tamanhos de bloco suportados: potências de dois de 64 a 8192 (o tamanho vai
+// no cabeçalho, em 16 bits). Os núcleos do codec (DCT, quantização, escrita e
+// leitura dos coeficientes) são instanciados para cada um (withBlockSize).
+constexpr std::size_t MIN_BLOCK_SIZE = 64;
+constexpr std::size_t MAX_BLOCK_SIZE = 8192;
+// Número de blocos entregues a cada thread em cada lote do modo paralelo
+constexpr std::size_t BLOCKS_PER_THREAD = 16;
+
+// O formato original começa diretamente pelo sample rate. O formato v2 começa
+// por uma marca (impossível como sample rate), seguida da versão e de flags.
+constexpr uint32_t FORMAT_MAGIC = 0x4C434443; // "LCDC"
+// Os arquivos com tabela de quantização ou débito alvo têm a versão 3, que
+// os decodificadores anteriores recusam; os restantes mantêm a versão 2.
+constexpr uint8_t FORMAT_VERSION = 3;
+// Tabela de posições dos blocos no fim do arquivo
+constexpr uint16_t FLAG_BLOCK_INDEX = 0x0001;
+// Coeficientes em Golomb-Rice adaptativo (CoefficientCoding::Rice)
+constexpr uint16_t FLAG_RICE_CODING = 0x0002;
+// Estéreo: cada bloco tem dois canais, mid e side, em vez da média de L e R
+constexpr uint16_t FLAG_MID_SIDE = 0x0004;
+// Tabela de quantização no cabeçalho, em vez da original (v3)
+constexpr uint16_t FLAG_QUANT_TABLE = 0x0008;
+// Débito alvo: cada bloco tem o código da sua escala de quantização (v3)
+constexpr uint16_t FLAG_RATE_CONTROL = 0x0010;
+constexpr uint16_t FORMAT_V3_FLAGS = FLAG_QUANT_TABLE | FLAG_RATE_CONTROL;
+
+// Escala dos passos de um bloco no modo de débito alvo: 2^((código - 64) / 8),
+// com o código em 8 bits (de 1/256 a quase 2^24, em passos de cerca de 9%)
+constexpr int SCALE_CODE_BITS = 8;
+constexpr int SCALE_CODE_UNITY = 64;
+constexpr int SCALE_CODES_PER_OCTAVE = 8;
+
+// Golomb-Rice: número de 1s do prefixo unário a partir do qual o valor segue
+// em binário (32 bits), limitando o comprimento de cada código
+constexpr int RICE_ESCAPE = 24;
+// As estatísticas do parâmetro adaptativo são reduzidas a metade a cada
+// RICE_RESET valores, para acompanhar a variação ao longo do bloco
+constexpr uint32_t RICE_RESET = 32;
 
 namespace {
 
-void applyDCT(const std::vector<double>& input, std::vector<double>& output) {
-    for (std::size_t k = 0; k < BLOCK_SIZE; ++k) {
-        double sum = 0.0;
-        const double blockSizeAsDouble = static_cast<double>(BLOCK_SIZE);
-        const double scale = (k == 0) ? 1.0 / std::sqrt(blockSizeAsDouble)
-                                      : std::sqrt(2.0 / blockSizeAsDouble);
+struct StreamHeader {
+    uint8_t version = 1;
+    uint16_t flags = 0;
+    int sampleRate = 0;
+    sf_count_t totalFrames = 0;
+    int blockSize = 0;
+    QuantizationProfile quantization;
+};
 
-        for (std::size_t n = 0; n < BLOCK_SIZE; ++n) {
-            const double angleNumerator =
-                PI * (2.0 * static_cast<double>(n) + 1.0) * static_cast<double>(k);
-            sum += input[n] * std::cos(angleNumerator / (2.0 * blockSizeAsDouble));
+void writeHeader(BitStream& bs, const StreamHeader& header) {
+    if (header.version >= 2) {
+        bs.write_n_bits(FORMAT_MAGIC, 32);
+        bs.write_n_bits(header.version, 8);
+        bs.write_n_bits(header.flags, 16);
+    }
+    // 1. Sample rate (32 bits)
+    bs.write_n_bits(static_cast<uint64_t>(header.sampleRate), 32);
+    // 2. Número total de frames (32 bits)
+    bs.write_n_bits(static_cast<uint64_t>(header.totalFrames), 32);
+    // 3. Tamanho do bloco (16 bits)
+    bs.write_n_bits(static_cast<uint64_t>(header.blockSize), 16);
+    // 4. Tabela de quantização (v3): número de passos (16 bits) e cada passo em
+    // IEEE 754 (64 bits), para que o decodificador use exatamente os mesmos
+    if (header.flags & FLAG_QUANT_TABLE) {
+        const std::vector<double>& steps = header.quantization.steps();
+        bs.write_n_bits(steps.size(), 16);
+        for (const double step : steps) {
+            bs.write_n_bits(std::bit_cast<uint64_t>(step), 64);
         }
+    }
+}
 
-        output[k] = scale * sum;
+bool isSupportedBlockSize(std::size_t blockSize) {
+    return blockSize >= MIN_BLOCK_SIZE && blockSize <= MAX_BLOCK_SIZE && (blockSize & (blockSize - 1)) == 0;
+}
+
+// Chama function(std::integral_constant<std::size_t, N>{}) com N = blockSize,
+// que tem de ser um tamanho suportado
+template <typename Function>
+decltype(auto) withBlockSize(std::size_t blockSize, Function&& function) {
+    switch (blockSize) {
+        case 64: return function(std::integral_constant<std::size_t, 64>{});
+        case 128: return function(std::integral_constant<std::size_t, 128>{});
+        case 256: return function(std::integral_constant<std::size_t, 256>{});
+        case 512: return function(std::integral_constant<std::size_t, 512>{});
+        case 1024: return function(std::integral_constant<std::size_t, 1024>{});
+        case 2048: return function(std::integral_constant<std::size_t, 2048>{});
+        case 4096: return function(std::integral_constant<std::size_t, 4096>{});
+        case 8192: return function(std::integral_constant<std::size_t, 8192>{});
+        default: throw std::logic_error("Tamanho do bloco não suportado: " + std::to_string(blockSize));
     }
 }
 
-void applyIDCT(const std::vector<double>& input, std::vector<double>& output) {
-    const double blockSizeAsDouble = static_cast<double>(BLOCK_SIZE);
-    const double dcScale = 1.0 / std::sqrt(blockSizeAsDouble);
-    const double acScale = std::sqrt(2.0 / blockSizeAsDouble);
+StreamHeader readHeader(BitStream& bs) {
+    StreamHeader header;
+    uint64_t field = bs.read_n_bits(32);
+    if (field == FORMAT_MAGIC) {
+        header.version = static_cast<uint8_t>(bs.read_n_bits(8));
+        header.flags = static_cast<uint16_t>(bs.read_n_bits(16));
+        if (header.version < 2 || header.version > FORMAT_VERSION ||
+            (header.version < 3 && (header.flags & FORMAT_V3_FLAGS))) {
+            throw std::runtime_error("Versão do formato não suportada: " + std::to_string(header.version));
+        }
+        field = bs.read_n_bits(32);
+    }
+    header.sampleRate = static_cast<int>(field);
+    header.totalFrames = static_cast<sf_count_t>(bs.read_n_bits(32));
+    header.blockSize = static_cast<int>(bs.read_n_bits(16));
 
-    for (std::size_t n = 0; n < BLOCK_SIZE; ++n) {
-        double sum = input[0] * dcScale;
+    if (!isSupportedBlockSize(static_cast<std::size_t>(header.blockSize))) {
+        throw std::runtime_error("Tamanho do bloco não suportado: " + std::to_string(header.blockSize));
+    }
 
-        for (std::size_t k = 1; k < BLOCK_SIZE; ++k) {
-            const double angleNumerator =
-                PI * (2.0 * static_cast<double>(n) + 1.0) * static_cast<double>(k);
-            sum += acScale * input[k] * std::cos(angleNumerator / (2.0 * blockSizeAsDouble));
+    if (header.flags & FLAG_QUANT_TABLE) {
+        std::vector<double> steps(bs.read_n_bits(16));
+        for (double& step : steps) {
+            step = std::bit_cast<double>(bs.read_n_bits(64));
+        }
+        try {
+            header.quantization = QuantizationProfile(std::move(steps));
+        } catch (const std::invalid_argument&) {
+            throw std::runtime_error("Tabela de quantização inválida no cabeçalho");
         }
+    }
+    return header;
+}
 
-        output[n] = sum;
+double blockScale(int scaleCode) {
+    return std::exp2(static_cast<double>(scaleCode - SCALE_CODE_UNITY) / SCALE_CODES_PER_OCTAVE);
+}
+
+CoefficientCoding codingFromHeader(const StreamHeader& header) {
+    return (header.flags & FLAG_RICE_CODING) ? CoefficientCoding::Rice : CoefficientCoding::Fixed;
+}
+
+// Índice de blocos: alinhado ao byte, contém o número de blocos (32 bits) e a
+// posição em bits do início de cada bloco (64 bits cada); os últimos 8 bytes do
+// arquivo guardam a posição (em bytes) do índice
+void writeBlockIndex(BitStream& bs, const std::vector<uint64_t>& blockOffsets) {
+    const int padding = static_cast<int>((8 - bs.tell_bits() % 8) % 8);
+    bs.write_n_bits(0, padding);
+
+    const uint64_t indexStart = bs.tell_bits() / 8;
+    bs.write_n_bits(blockOffsets.size(), 32);
+    for (const uint64_t offset : blockOffsets) {
+        bs.write_n_bits(offset, 64);
+    }
+    bs.write_n_bits(indexStart, 64);
+}
+
+// Posição (em bits) do bloco "block", lida diretamente da entrada do índice
+uint64_t blockOffsetFromIndex(BitStream& bs, uint64_t fileSize, std::size_t block, std::size_t nBlocks) {
+    if (fileSize < 12) {
+        throw std::runtime_error("Índice de blocos em falta ou corrompido");
     }
+    bs.seek_bits((fileSize - 8) * 8);
+    const uint64_t indexStart = bs.read_n_bits(64);
+    if (indexStart + 4 + 8 * static_cast<uint64_t>(nBlocks) + 8 != fileSize) {
+        throw std::runtime_error("Índice de blocos em falta ou corrompido");
+    }
+
+    bs.seek_bits(indexStart * 8);
+    if (bs.read_n_bits(32) != nBlocks) {
+        throw std::runtime_error("Índice de blocos inconsistente com o cabeçalho");
+    }
+    bs.seek_bits((indexStart + 4 + 8 * static_cast<uint64_t>(block)) * 8);
+    return bs.read_n_bits(64);
 }
 
 short clampToInt16(double sample) {
@@ -84,193 +228,836 @@ uint8_t bitsNeededForMagnitude(uint32_t magnitude) {
 #endif
 }
 
-} // namespace
+// Parâmetro de Golomb-Rice adaptativo (como no LOCO-I): o menor k tal que
+// count * 2^k >= sum, onde sum é a soma dos valores recentes. O estado é
+// reiniciado em cada bloco, que assim continua independente dos outros.
+class AdaptiveRice {
+public:
+    explicit AdaptiveRice(uint32_t initialMean) : m_sum(initialMean) {}
 
-void encodeWav(const std::string &inputWav, const std::string &outputFile) {
-    // Abrir o arquivo WAV de entrada
-    SndfileHandle sf(inputWav);
-    if (sf.error()) {
-        throw std::runtime_error("Erro ao abrir o arquivo WAV: " + inputWav);
+    int parameter() const {
+        int k = 0;
+        while ((m_count << k) < m_sum && k < 31) {
+            ++k;
+        }
+        return k;
     }
 
-    int channels = sf.channels();
-    if (channels > 2) {
-        throw std::runtime_error("Apenas arquivos WAV mono ou estéreo são suportados");
+    void update(uint32_t value) {
+        m_sum += value;
+        if (++m_count == RICE_RESET) {
+            m_sum >>= 1;
+            m_count >>= 1;
+        }
     }
 
-    // Criar arquivo de saída
-    std::fstream fs(outputFile, std::ios::out | std::ios::binary);
-    if (!fs) {
-        throw std::runtime_error("Erro ao criar arquivo de saída: " + outputFile);
+private:
+    uint64_t m_sum;
+    uint64_t m_count = 1;
+};
+
+template <typename BitSink>
+void writeRice(BitSink& out, uint32_t value, int k) {
+    const uint32_t quotient = value >> k;
+    if (quotient < RICE_ESCAPE) {
+        // quotient 1s, um 0 e os k bits menos significativos, numa só escrita
+        const uint64_t prefix = ((uint64_t{1} << quotient) - 1) << 1;
+        const uint64_t remainder = value & ((uint64_t{1} << k) - 1);
+        out.write_n_bits((prefix << k) | remainder, static_cast<int>(quotient) + 1 + k);
+    } else {
+        out.write_n_bits((uint64_t{1} << RICE_ESCAPE) - 1, RICE_ESCAPE);
+        out.write_n_bits(value, 32);
     }
-    fs.seekp(0); // Ir para o início do arquivo para escrita
-    BitStream bs(fs, false);  // false para modo de escrita
+}
 
-    // Escrever cabeçalho
-    // 1. Sample rate (32 bits)
-    bs.write_n_bits(static_cast<uint64_t>(sf.samplerate()), 32);
-    // 2. Número total de frames (32 bits)
-    bs.write_n_bits(static_cast<uint64_t>(sf.frames()), 32);
-    // 3. Tamanho do bloco (16 bits)
-    bs.write_n_bits(static_cast<uint64_t>(BLOCK_SIZE), 16);
+uint32_t readRice(BitStream& bs, int k) {
+    const int quotient = bs.read_unary(RICE_ESCAPE);
+    if (quotient == RICE_ESCAPE) {
+        return static_cast<uint32_t>(bs.read_n_bits(32));
+    }
+    return (static_cast<uint32_t>(quotient) << k) | static_cast<uint32_t>(bs.read_n_bits(k));
+}
 
-    std::cout << "Informações do arquivo:\n";
-    std::cout << "Sample rate: " << sf.samplerate() << " Hz\n";
-    std::cout << "Channels: " << sf.channels() << "\n";
-    std::cout << "Frames: " << sf.frames() << "\n";
+// Destino de bits que só os conta, para medir o tamanho de um bloco sem o escrever
+struct BitCounter {
+    uint64_t bits = 0;
+
+    void write_bit(int) { ++bits; }
+    void write_n_bits(uint64_t, int n) { bits += static_cast<uint64_t>(n); }
+};
+
+// Modo Rice: alternam comprimentos de sequências de zeros e coeficientes não
+// nulos (bit de sinal + magnitude - 1). Uma sequência que chega ao fim do bloco
+// termina-o, tal como um coeficiente não nulo na última posição.
+template <typename BitSink, std::size_t BlockSize>
+void writeRiceCoefficients(BitSink& out, const std::array<int32_t, BlockSize>& quantizedBlock) {
+    AdaptiveRice runModel(4);
+    AdaptiveRice magnitudeModel(4);
+    constexpr std::size_t size = BlockSize;
+
+    std::size_t pos = 0;
+    while (pos < size) {
+        std::size_t end = pos;
+        while (end < size && quantizedBlock[end] == 0) {
+            ++end;
+        }
+        const uint32_t run = static_cast<uint32_t>(end - pos);
+        writeRice(out, run, runModel.parameter());
+        runModel.update(run);
+        pos = end;
+        if (pos == size) {
+            break;
+        }
+
+        const int32_t coef = quantizedBlock[pos++];
+        const uint32_t magnitude = magnitudeFromCoefficient(coef);
+        out.write_bit(coef < 0 ? 1 : 0);
+        writeRice(out, magnitude - 1, magnitudeModel.parameter());
+        magnitudeModel.update(magnitude - 1);
+    }
+}
+
+template <std::size_t BlockSize>
+void readRiceCoefficients(BitStream& bs, std::array<int32_t, BlockSize>& quantizedBlock) {
+    AdaptiveRice runModel(4);
+    AdaptiveRice magnitudeModel(4);
+    constexpr std::size_t size = BlockSize;
+
+    std::size_t pos = 0;
+    while (pos < size) {
+        const uint32_t run = readRice(bs, runModel.parameter());
+        runModel.update(run);
+        if (run > size - pos) {
+            throw std::runtime_error("Sequência de zeros inválida no fluxo codificado");
+        }
+        std::fill_n(quantizedBlock.begin() + static_cast<std::ptrdiff_t>(pos), run, 0);
+        pos += run;
+        if (pos == size) {
+            break;
+        }
+
+        const bool isNegative = bs.read_bit() == 1;
+        const uint32_t magnitudeMinusOne = readRice(bs, magnitudeModel.parameter());
+        magnitudeModel.update(magnitudeMinusOne);
+        if (magnitudeMinusOne >= static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+            throw std::runtime_error("Magnitude de coeficiente excede o intervalo suportado");
+        }
+        const int32_t magnitude = static_cast<int32_t>(magnitudeMinusOne) + 1;
+        quantizedBlock[pos++] = isNegative ? -magnitude : magnitude;
+    }
+}
+
+// Abre o fluxo de bits do arquivo através de fs, ou diretamente pelo caminho
+// com a memória mapeada (leitura por mmap, escrita em lotes grandes)
+std::unique_ptr<BitStream> openBitStream(const std::string& path, bool rwStatus, bool memoryMapped,
+                                         std::fstream& fs) {
+    if (memoryMapped) {
+        auto bs = std::make_unique<BitStream>(path, rwStatus);
+        return bs->is_open() ? std::move(bs) : nullptr;
+    }
+
+    fs.open(path, (rwStatus ? std::ios::in : std::ios::out) | std::ios::binary);
+    return fs ? std::make_unique<BitStream>(fs, rwStatus) : nullptr;
+}
+
+// Buffers de trabalho de um bloco; cada thread usa o seu
+template <std::size_t BlockSize>
+struct BlockWorkspace {
+    FixedFastDCT<BlockSize> dct;
+    std::array<double, BlockSize> samples{};
+    std::array<double, BlockSize> coefficients{};
+    std::array<int32_t, BlockSize> quantized{};
+    // Coeficientes de todos os canais do bloco (modo de débito alvo)
+    std::array<double, 2 * BlockSize> blockCoefficients{};
+};
+
+// Threads criadas uma vez por codificação ou decodificação. start(count, task)
+// distribui task(worker, i), para os i em [0, count), dinamicamente pelas
+// threads e retorna logo, para que quem a chama possa ler ou escrever outro
+// lote entretanto; wait() espera que terminem. worker (0..nThreads-1)
+// identifica a thread. Com uma só thread não há threads auxiliares e start
+// executa tudo antes de retornar.
+class WorkerPool {
+public:
+    using Task = std::function<void(unsigned, std::size_t)>;
+
+    explicit WorkerPool(unsigned nThreads) {
+        if (nThreads > 1) {
+            for (unsigned worker = 0; worker < nThreads; ++worker) {
+                m_threads.emplace_back([this, worker] { work(worker); });
+            }
+        }
+        m_finished = m_threads.size();
+    }
+
+    // Espera pelo lote em curso (se houver) e termina as threads
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_all();
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void start(std::size_t count, Task task) {
+        if (m_threads.empty()) {
+            for (std::size_t i = 0; i < count; ++i) {
+                task(0U, i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = std::move(task);
+            m_count = count;
+            m_next = 0;
+            m_finished = 0;
+            ++m_generation;
+        }
+        m_ready.notify_all();
+    }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_finished == m_threads.size(); });
+    }
+
+private:
+    void work(unsigned worker) {
+        std::size_t seen = 0;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_ready.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_generation == seen) {
+                return;
+            }
+            seen = m_generation;
+            lock.unlock();
+
+            for (std::size_t i; (i = m_next++) < m_count;) {
+                m_task(worker, i);
+            }
+
+            lock.lock();
+            if (++m_finished == m_threads.size()) {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_done;
+    Task m_task;
+    std::size_t m_count = 0;
+    std::atomic<std::size_t> m_next{0};
+    std::size_t m_generation = 0;
+    std::size_t m_finished = 0;
+    bool m_stop = false;
+};
+
+// Sinal codificado em cada canal de um bloco
+enum class ChannelSignal {
+    Mono, // canal único, ou média de L e R (formato original)
+    Mid,  // (L + R) / 2
+    Side  // (L - R) / 2
+};
+
+int codedChannels(const StreamHeader& header) {
+    return (header.flags & FLAG_MID_SIDE) ? 2 : 1;
+}
+
+ChannelSignal channelSignal(int nCodedChannels, int channel) {
+    if (nCodedChannels == 1) {
+        return ChannelSignal::Mono;
+    }
+    return channel == 0 ? ChannelSignal::Mid : ChannelSignal::Side;
+}
+
+// Prepara um canal de um bloco e aplica-lhe a DCT (coeficientes em ws.coefficients)
+template <std::size_t BlockSize>
+void transformChannel(BlockWorkspace<BlockSize>& ws, const short* frames, std::size_t framesRead, int channels,
+                      ChannelSignal signal) {
+    // Preparar o bloco em double (mono: média simples de L e R, como no formato original)
+    if (channels == 1) {
+        for (std::size_t i = 0; i < framesRead; ++i) {
+            ws.samples[i] = static_cast<double>(frames[i]);
+        }
+    } else {
+        for (std::size_t i = 0; i < framesRead; ++i) {
+            const int left = static_cast<int>(frames[2 * i]);
+            const int right = static_cast<int>(frames[2 * i + 1]);
+            switch (signal) {
+                case ChannelSignal::Mono: ws.samples[i] = static_cast<double>((left + right) / 2); break;
+                case ChannelSignal::Mid: ws.samples[i] = (left + right) / 2.0; break;
+                case ChannelSignal::Side: ws.samples[i] = (left - right) / 2.0; break;
+            }
+        }
+    }
+
+    // Zero-pad do bloco caso não esteja completo
+    for (std::size_t i = framesRead; i < BlockSize; ++i) {
+        ws.samples[i] = 0.0;
+    }
+
+    // Aplicar DCT no bloco
+    ws.dct.forward(ws.samples, ws.coefficients);
+}
+
+// Quantiza e escreve os coeficientes de um canal: bits dedicados à magnitude
+// (6 bits) e coeficientes, ou só os coeficientes no modo Rice. O destino pode
+// ser o BitStream, um BitBuffer (modo paralelo) ou um BitCounter.
+template <std::size_t BlockSize, typename BitSink>
+void writeChannel(BlockWorkspace<BlockSize>& ws, std::type_identity_t<std::span<const double, BlockSize>> coefficients,
+                  const QuantizationProfile& quantization, double scale, CoefficientCoding coding, BitSink& out) {
+    // Quantizar os coeficientes (no buffer do workspace, sem alocações)
+    quantizeDCTBlock<BlockSize>(coefficients, ws.quantized, quantization, scale);
+    const auto& quantizedBlock = ws.quantized;
+
+    if (coding == CoefficientCoding::Rice) {
+        writeRiceCoefficients(out, quantizedBlock);
+        return;
+    }
+
+    // Determinar o número de bits necessários para representar o valor absoluto máximo
+    uint32_t maxMagnitude = 0;
+    for (const auto coef : quantizedBlock) {
+        maxMagnitude = std::max(maxMagnitude, magnitudeFromCoefficient(coef));
+    }
+    const uint8_t magnitudeBits =
+        bitsNeededForMagnitude(maxMagnitude);
+
+    // Escrever os bits dedicados à magnitude (6 bits)
+    out.write_n_bits(static_cast<uint64_t>(magnitudeBits), 6);
+
+    // Escrever os coeficientes quantizados (bit de sinal + magnitude)
+    for (const auto coef : quantizedBlock) {
+        const bool isNegative = coef < 0;
+        out.write_bit(isNegative ? 1 : 0);
+
+        if (magnitudeBits > 0) {
+            const uint32_t magnitude =
+                isNegative ? static_cast<uint32_t>(-static_cast<long long>(coef))
+                           : static_cast<uint32_t>(coef);
+            out.write_n_bits(static_cast<uint64_t>(magnitude), magnitudeBits);
+        }
+    }
+}
+
+// Transforma, quantiza e escreve um canal de um bloco. Cada bloco é o seu
+// número de frames (16 bits), o código da escala (8 bits, só com débito alvo)
+// e os seus canais.
+template <std::size_t BlockSize, typename BitSink>
+void encodeChannel(BlockWorkspace<BlockSize>& ws, const short* frames, std::size_t framesRead, int channels,
+                   ChannelSignal signal, const QuantizationProfile& quantization, CoefficientCoding coding,
+                   BitSink& out) {
+    transformChannel(ws, frames, framesRead, channels, signal);
+    writeChannel(ws, ws.coefficients, quantization, 1.0, coding, out);
+}
+
+// Débito alvo: escreve o código da escala e os canais de um bloco, com o menor
+// código (passos mais finos) com que cabem em budgetBits. O tamanho decresce
+// com a escala, pelo que o código é procurado por pesquisa binária, contando
+// os bits de cada tentativa sem os escrever; se nenhum couber, usa o maior.
+template <std::size_t BlockSize, typename BitSink>
+void encodeRateControlledBlock(BlockWorkspace<BlockSize>& ws, const short* frames, std::size_t framesRead, int channels,
+                               int nCodedChannels, const QuantizationProfile& quantization, CoefficientCoding coding,
+                               uint64_t budgetBits, BitSink& out) {
+    for (int c = 0; c < nCodedChannels; ++c) {
+        transformChannel(ws, frames, framesRead, channels, channelSignal(nCodedChannels, c));
+        std::copy(ws.coefficients.begin(), ws.coefficients.end(),
+                  ws.blockCoefficients.begin() + static_cast<std::ptrdiff_t>(c * BlockSize));
+    }
+
+    const auto writeBlock = [&](auto& sink, int scaleCode) {
+        sink.write_n_bits(static_cast<uint64_t>(scaleCode), SCALE_CODE_BITS);
+        for (int c = 0; c < nCodedChannels; ++c) {
+            const std::span<const double, BlockSize> coefficients(ws.blockCoefficients.data() + c * BlockSize,
+                                                                  BlockSize);
+            writeChannel(ws, coefficients, quantization, blockScale(scaleCode), coding, sink);
+        }
+    };
+
+    int low = 0;
+    int high = (1 << SCALE_CODE_BITS) - 1;
+    while (low < high) {
+        const int middle = (low + high) / 2;
+        BitCounter counter;
+        writeBlock(counter, middle);
+        if (counter.bits <= budgetBits) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    writeBlock(out, low);
+}
+
+struct BlockHeader {
+    int frames = 0;
+    double scale = 1.0; // escala dos passos de quantização do bloco
+};
+
+// Lê o número de frames de um bloco e, com débito alvo, o código da sua escala
+BlockHeader readBlockHeader(BitStream& bs, const StreamHeader& header) {
+    BlockHeader block;
+    block.frames = static_cast<int>(bs.read_n_bits(16));
+    if (block.frames <= 0 || block.frames > header.blockSize) {
+        throw std::runtime_error("Tamanho de bloco inválido ou corrompido no fluxo codificado");
+    }
+    if (header.flags & FLAG_RATE_CONTROL) {
+        block.scale = blockScale(static_cast<int>(bs.read_n_bits(SCALE_CODE_BITS)));
+    }
+    return block;
+}
+
+// Lê os coeficientes quantizados de um canal de um bloco
+template <std::size_t BlockSize>
+void readChannel(BitStream& bs, CoefficientCoding coding, std::array<int32_t, BlockSize>& quantizedBlock) {
+    if (coding == CoefficientCoding::Rice) {
+        readRiceCoefficients(bs, quantizedBlock);
+        return;
+    }
+
+    const uint8_t magnitudeBits = static_cast<uint8_t>(bs.read_n_bits(6));
+    if (magnitudeBits > 32) {
+        throw std::runtime_error("Número de bits da magnitude inválido no fluxo codificado");
+    }
+
+    for (std::size_t i = 0; i < BlockSize; ++i) {
+        const uint64_t signBit = bs.read_n_bits(1);
+        int32_t value = 0;
+
+        if (magnitudeBits > 0) {
+            const uint64_t magnitude = bs.read_n_bits(magnitudeBits);
+            if (magnitude > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
+                throw std::runtime_error("Magnitude de coeficiente excede o intervalo suportado");
+            }
+
+            value = signBit ? -static_cast<int32_t>(magnitude)
+                            : static_cast<int32_t>(magnitude);
+        }
+
+        quantizedBlock[i] = value;
+    }
+}
+
+// Dequantiza e aplica a IDCT aos coeficientes de um canal (BlockSize amostras)
+template <std::size_t BlockSize>
+void reconstructChannel(BlockWorkspace<BlockSize>& ws, const std::array<int32_t, BlockSize>& quantizedBlock,
+                        const QuantizationProfile& quantization, double scale, double* samples) {
+    dequantizeDCTBlock<BlockSize>(quantizedBlock, ws.coefficients, quantization, scale);
+    ws.dct.inverse(ws.coefficients, std::span<double, BlockSize>(samples, BlockSize));
+}
+
+// Converte os canais reconstruídos de um bloco (BlockSize amostras cada, por
+// ordem) em PCM intercalado; em mid/side, L = M + S e R = M - S
+template <std::size_t BlockSize>
+void toPcm(const double* channelSamples, int nCodedChannels, short* pcm) {
+    if (nCodedChannels == 1) {
+        for (std::size_t i = 0; i < BlockSize; ++i) {
+            pcm[i] = clampToInt16(channelSamples[i]);
+        }
+        return;
+    }
+
+    const double* mid = channelSamples;
+    const double* side = channelSamples + BlockSize;
+    for (std::size_t i = 0; i < BlockSize; ++i) {
+        pcm[2 * i] = clampToInt16(mid[i] + side[i]);
+        pcm[2 * i + 1] = clampToInt16(mid[i] - side[i]);
+    }
+}
+
+// Codifica os blocos de sf, depois do cabeçalho, e devolve o seu número
+// (guardando a posição de cada um em blockOffsets)
+template <std::size_t BlockSize>
+int encodeBlocks(SndfileHandle& sf, BitStream& bs, const StreamHeader& header, const EncoderOptions& options,
+                 std::vector<uint64_t>& blockOffsets) {
+    const int channels = sf.channels();
+    const bool rateControlled = (header.flags & FLAG_RATE_CONTROL) != 0;
+    const int nCoded = codedChannels(header);
+    const unsigned nWorkers = std::max(1U, options.nThreads);
+    const std::size_t batchBlocks = nWorkers == 1 ? 1 : nWorkers * BLOCKS_PER_THREAD;
+
+    // Um lote de blocos lidos do arquivo e, no modo paralelo, os bits de cada
+    // canal de cada bloco (ou de cada bloco, com débito alvo)
+    struct Batch {
+        std::vector<short> frames;
+        std::vector<BitBuffer> bits;
+        std::size_t framesRead = 0;
+        std::size_t nBlocks = 0;
+    };
 
-    // Criar buffers para as amostras
-    std::vector<short> readBuffer(BLOCK_SIZE * static_cast<std::size_t>(channels));
-    std::vector<double> monoBlock(BLOCK_SIZE);
-    std::vector<double> dctCoefficients(BLOCK_SIZE);
+    const auto readBatch = [&](Batch& batch) {
+        const sf_count_t framesRead = sf.readf(batch.frames.data(), static_cast<sf_count_t>(batchBlocks * BlockSize));
+        batch.framesRead = static_cast<std::size_t>(std::max<sf_count_t>(framesRead, 0));
+        batch.nBlocks = (batch.framesRead + BlockSize - 1) / BlockSize;
+        return batch.nBlocks > 0;
+    };
+    const auto framesInBlock = [&](const Batch& batch, std::size_t b) {
+        return std::min(BlockSize, batch.framesRead - b * BlockSize);
+    };
+    const auto blockFrames = [&](const Batch& batch, std::size_t b) {
+        return batch.frames.data() + b * BlockSize * static_cast<std::size_t>(channels);
+    };
+    // Bits do débito alvo para o resto do bloco (além do número de frames)
+    const auto budgetBits = [&](const Batch& batch, std::size_t b) {
+        const double bits =
+            options.targetKbps * 1000.0 * static_cast<double>(framesInBlock(batch, b)) / sf.samplerate();
+        return static_cast<uint64_t>(std::max(0.0, std::floor(bits) - 16.0));
+    };
 
-    sf_count_t framesRead;
     int blockCount = 0;
+    const auto countBlocks = [&](const Batch& batch) {
+        for (std::size_t b = 0; b < batch.nBlocks; ++b) {
+            blockCount++;
+            if (blockCount <= 5 || blockCount % 200 == 0) {
+                std::cout << "Processado bloco " << blockCount << " com " << framesInBlock(batch, b) << " frames\n";
+            }
+        }
+    };
+
+    std::vector<BlockWorkspace<BlockSize>> workspaces(nWorkers);
+    Batch batches[2];
+    for (Batch& batch : batches) {
+        batch.frames.resize(batchBlocks * BlockSize * static_cast<std::size_t>(channels));
+        batch.bits.resize(batchBlocks * static_cast<std::size_t>(nCoded));
+    }
 
-    while ((framesRead = sf.readf(readBuffer.data(), BLOCK_SIZE)) > 0) {
-        // Converter para mono (média simples) e preparar o bloco em double
-        if (channels == 2) {
-            for (sf_count_t i = 0; i < framesRead; ++i) {
-                const int left = static_cast<int>(readBuffer[2 * i]);
-                const int right = static_cast<int>(readBuffer[2 * i + 1]);
-                monoBlock[static_cast<std::size_t>(i)] = static_cast<double>((left + right) / 2);
+    // Modo sequencial: cada bloco é codificado diretamente para o BitStream
+    if (nWorkers == 1) {
+        Batch& batch = batches[0];
+        while (readBatch(batch)) {
+            blockOffsets.push_back(bs.tell_bits());
+            bs.write_n_bits(static_cast<uint64_t>(framesInBlock(batch, 0)), 16);
+            if (rateControlled) {
+                encodeRateControlledBlock(workspaces[0], blockFrames(batch, 0), framesInBlock(batch, 0), channels,
+                                          nCoded, header.quantization, options.coding, budgetBits(batch, 0), bs);
+            } else {
+                for (int c = 0; c < nCoded; ++c) {
+                    encodeChannel(workspaces[0], blockFrames(batch, 0), framesInBlock(batch, 0), channels,
+                                  channelSignal(nCoded, c), header.quantization, options.coding, bs);
+                }
             }
+            countBlocks(batch);
+        }
+        return blockCount;
+    }
+
+    // Modo paralelo: cada canal de cada bloco de um lote é codificado por uma
+    // thread para o seu BitBuffer (com débito alvo a escala é comum aos canais
+    // do bloco, que é então a unidade de trabalho, escrita para o BitBuffer do
+    // seu primeiro canal). Enquanto as threads codificam um lote, a thread
+    // principal escreve por ordem os buffers do anterior e lê o seguinte.
+    const auto startBatch = [&](WorkerPool& pool, Batch& batch) {
+        if (rateControlled) {
+            pool.start(batch.nBlocks, [&](unsigned worker, std::size_t b) {
+                BitBuffer& blockBits = batch.bits[b * static_cast<std::size_t>(nCoded)];
+                blockBits.clear();
+                encodeRateControlledBlock(workspaces[worker], blockFrames(batch, b), framesInBlock(batch, b), channels,
+                                          nCoded, header.quantization, options.coding, budgetBits(batch, b),
+                                          blockBits);
+            });
         } else {
-            for (sf_count_t i = 0; i < framesRead; ++i) {
-                monoBlock[static_cast<std::size_t>(i)] = static_cast<double>(readBuffer[static_cast<std::size_t>(i)]);
+            pool.start(batch.nBlocks * static_cast<std::size_t>(nCoded), [&](unsigned worker, std::size_t u) {
+                const std::size_t b = u / static_cast<std::size_t>(nCoded);
+                const int c = static_cast<int>(u % static_cast<std::size_t>(nCoded));
+                batch.bits[u].clear();
+                encodeChannel(workspaces[worker], blockFrames(batch, b), framesInBlock(batch, b), channels,
+                              channelSignal(nCoded, c), header.quantization, options.coding, batch.bits[u]);
+            });
+        }
+    };
+    const auto writeBatch = [&](Batch& batch) {
+        const int unitsPerBlock = rateControlled ? 1 : nCoded;
+        for (std::size_t b = 0; b < batch.nBlocks; ++b) {
+            blockOffsets.push_back(bs.tell_bits());
+            bs.write_n_bits(static_cast<uint64_t>(framesInBlock(batch, b)), 16);
+            for (int c = 0; c < unitsPerBlock; ++c) {
+                batch.bits[b * static_cast<std::size_t>(nCoded) + static_cast<std::size_t>(c)].write_to(bs);
             }
         }
+        countBlocks(batch);
+    };
+
+    WorkerPool pool(nWorkers);
+    int current = 0;
+    bool hasPrevious = false;
+    bool hasCurrent = readBatch(batches[current]);
+    while (hasCurrent) {
+        startBatch(pool, batches[current]);
+        Batch& other = batches[1 - current];
+        if (hasPrevious) {
+            writeBatch(other);
+        }
+        const bool hasNext = readBatch(other);
+        pool.wait();
+
+        hasPrevious = true;
+        hasCurrent = hasNext;
+        current = 1 - current;
+    }
+    if (hasPrevious) {
+        writeBatch(batches[1 - current]);
+    }
+
+    return blockCount;
+}
+
+// Decodifica os blocos do fluxo para sf e devolve o número de frames escritas
+template <std::size_t BlockSize>
+sf_count_t decodeBlocks(BitStream& bs, const StreamHeader& header, SndfileHandle& sf, const DecoderOptions& options,
+                        int& blockCount) {
+    const sf_count_t totalFrames = header.totalFrames;
+    const CoefficientCoding coding = codingFromHeader(header);
+    const int nCoded = codedChannels(header);
+
+    // A leitura do fluxo é sequencial (os blocos têm tamanho variável); a
+    // dequantização e a IDCT de cada canal de cada lote de blocos são feitas
+    // pelas threads, enquanto a thread principal escreve o lote anterior e lê
+    // o seguinte (dois lotes em uso alternado)
+    const unsigned nWorkers = std::max(1U, options.nThreads);
+    const std::size_t batchBlocks = nWorkers == 1 ? 1 : nWorkers * BLOCKS_PER_THREAD;
+    const std::size_t batchChannels = batchBlocks * static_cast<std::size_t>(nCoded);
+
+    struct Batch {
+        std::vector<std::array<int32_t, BlockSize>> quantizedChannels;
+        std::vector<double> channelSamples;
+        std::vector<BlockHeader> blocks;
+        std::size_t nBlocks = 0;
+    };
 
-        // Zero-pad do bloco caso não esteja completo
-        for (std::size_t i = static_cast<std::size_t>(framesRead); i < BLOCK_SIZE; ++i) {
-            monoBlock[i] = 0.0;
+    sf_count_t totalFramesRead = 0;
+    const auto readBatch = [&](Batch& batch) {
+        batch.nBlocks = 0;
+        while (batch.nBlocks < batchBlocks && totalFramesRead < totalFrames) {
+            batch.blocks[batch.nBlocks] = readBlockHeader(bs, header);
+            for (int c = 0; c < nCoded; ++c) {
+                readChannel(bs, coding, batch.quantizedChannels[batch.nBlocks * static_cast<std::size_t>(nCoded) +
+                                                                static_cast<std::size_t>(c)]);
+            }
+            totalFramesRead += batch.blocks[batch.nBlocks].frames;
+            batch.nBlocks++;
         }
+        return batch.nBlocks > 0;
+    };
 
-        // Aplicar DCT no bloco
-        applyDCT(monoBlock, dctCoefficients);
+    std::array<short, 2 * BlockSize> pcmBlock;
+    sf_count_t totalFramesProcessed = 0;
+    const auto writeBatch = [&](const Batch& batch) {
+        for (std::size_t b = 0; b < batch.nBlocks; ++b) {
+            toPcm<BlockSize>(batch.channelSamples.data() + b * static_cast<std::size_t>(nCoded) * BlockSize, nCoded,
+                             pcmBlock.data());
+            sf.writef(pcmBlock.data(), batch.blocks[b].frames);
+            totalFramesProcessed += batch.blocks[b].frames;
+        }
+        blockCount += static_cast<int>(batch.nBlocks);
+    };
 
-        // Quantizar os coeficientes
-        const auto quantizedBlock = quantizeDCTCoefficients(dctCoefficients);
+    std::vector<BlockWorkspace<BlockSize>> workspaces(nWorkers);
+    Batch batches[2];
+    for (Batch& batch : batches) {
+        batch.quantizedChannels.resize(batchChannels);
+        batch.channelSamples.resize(batchChannels * BlockSize);
+        batch.blocks.resize(batchBlocks);
+    }
 
-        // Determinar o número de bits necessários para representar o valor absoluto máximo
-        uint32_t maxMagnitude = 0;
-        for (const auto coef : quantizedBlock) {
-            maxMagnitude = std::max(maxMagnitude, magnitudeFromCoefficient(coef));
+    WorkerPool pool(nWorkers);
+    int current = 0;
+    bool hasPrevious = false;
+    bool hasCurrent = readBatch(batches[current]);
+    while (hasCurrent) {
+        Batch& batch = batches[current];
+        pool.start(batch.nBlocks * static_cast<std::size_t>(nCoded), [&](unsigned worker, std::size_t u) {
+            reconstructChannel(workspaces[worker], batch.quantizedChannels[u], header.quantization,
+                               batch.blocks[u / static_cast<std::size_t>(nCoded)].scale,
+                               batch.channelSamples.data() + u * BlockSize);
+        });
+        Batch& other = batches[1 - current];
+        if (hasPrevious) {
+            writeBatch(other);
         }
-        const uint8_t magnitudeBits =
-            bitsNeededForMagnitude(maxMagnitude);
+        const bool hasNext = readBatch(other);
+        pool.wait();
 
-        // Escrever o tamanho do bloco (16 bits) e os bits dedicados à magnitude (6 bits)
-        bs.write_n_bits(static_cast<uint64_t>(framesRead), 16);
-        bs.write_n_bits(static_cast<uint64_t>(magnitudeBits), 6);
+        hasPrevious = true;
+        hasCurrent = hasNext;
+        current = 1 - current;
+    }
+    if (hasPrevious) {
+        writeBatch(batches[1 - current]);
+    }
+    return totalFramesProcessed;
+}
+
+// Decodifica para audio as frames [startFrame, startFrame + nFrames), já
+// limitadas ao arquivo, a partir do início do primeiro bloco
+template <std::size_t BlockSize>
+void decodeRangeBlocks(BitStream& bs, const StreamHeader& header, uint64_t fileSize, uint64_t startFrame,
+                       uint64_t nFrames, DecodedAudio& audio) {
+    const uint64_t totalFrames = static_cast<uint64_t>(header.totalFrames);
+    const CoefficientCoding coding = codingFromHeader(header);
+    const int nCoded = codedChannels(header);
 
-        // Escrever os coeficientes quantizados (bit de sinal + magnitude)
-        for (const auto coef : quantizedBlock) {
-            const bool isNegative = coef < 0;
-            bs.write_bit(isNegative ? 1 : 0);
+    // Todos os blocos exceto o último têm BlockSize frames
+    const std::size_t nBlocks = static_cast<std::size_t>((totalFrames + BlockSize - 1) / BlockSize);
+    const std::size_t firstBlock = static_cast<std::size_t>(startFrame / BlockSize);
+    const std::size_t lastBlock = static_cast<std::size_t>((startFrame + nFrames - 1) / BlockSize);
 
-            if (magnitudeBits > 0) {
-                const uint32_t magnitude =
-                    isNegative ? static_cast<uint32_t>(-static_cast<long long>(coef))
-                               : static_cast<uint32_t>(coef);
-                bs.write_n_bits(static_cast<uint64_t>(magnitude), magnitudeBits);
+    std::array<int32_t, BlockSize> quantizedBlock;
+    if (header.flags & FLAG_BLOCK_INDEX) {
+        bs.seek_bits(blockOffsetFromIndex(bs, fileSize, firstBlock, nBlocks));
+    } else {
+        for (std::size_t b = 0; b < firstBlock; ++b) {
+            readBlockHeader(bs, header);
+            for (int c = 0; c < nCoded; ++c) {
+                readChannel(bs, coding, quantizedBlock);
             }
         }
+    }
 
-        blockCount++;
-        if (blockCount <= 5 || blockCount % 200 == 0) {
-            std::cout << "Processado bloco " << blockCount << " com " << framesRead << " frames\n";
+    BlockWorkspace<BlockSize> ws;
+    std::array<double, 2 * BlockSize> channelSamples;
+    std::array<short, 2 * BlockSize> pcmBlock;
+    audio.samples.reserve(static_cast<std::size_t>(nFrames) * static_cast<std::size_t>(nCoded));
+    for (std::size_t b = firstBlock; b <= lastBlock; ++b) {
+        const BlockHeader block = readBlockHeader(bs, header);
+        const int framesInBlock = block.frames;
+        for (int c = 0; c < nCoded; ++c) {
+            readChannel(bs, coding, quantizedBlock);
+            reconstructChannel(ws, quantizedBlock, header.quantization, block.scale,
+                               channelSamples.data() + static_cast<std::size_t>(c) * BlockSize);
         }
+        toPcm<BlockSize>(channelSamples.data(), nCoded, pcmBlock.data());
+
+        const uint64_t blockStart = static_cast<uint64_t>(b) * BlockSize;
+        const uint64_t from = std::max(startFrame, blockStart) - blockStart;
+        const uint64_t to = std::min(startFrame + nFrames, blockStart + static_cast<uint64_t>(framesInBlock)) - blockStart;
+        audio.samples.insert(audio.samples.end(), pcmBlock.begin() + static_cast<std::ptrdiff_t>(from * nCoded),
+                             pcmBlock.begin() + static_cast<std::ptrdiff_t>(to * nCoded));
+    }
+}
+
+} // namespace
+
+void encodeWav(const std::string &inputWav, const std::string &outputFile, const EncoderOptions &options) {
+    // Abrir o arquivo WAV de entrada
+    SndfileHandle sf(inputWav);
+    if (sf.error()) {
+        throw std::runtime_error("Erro ao abrir o arquivo WAV: " + inputWav);
+    }
+
+    int channels = sf.channels();
+    if (channels > 2) {
+        throw std::runtime_error("Apenas arquivos WAV mono ou estéreo são suportados");
+    }
+    if (!std::isfinite(options.quantizationScale) || options.quantizationScale <= 0.0) {
+        throw std::runtime_error("Escala de quantização inválida");
+    }
+    if (!std::isfinite(options.targetKbps) || options.targetKbps < 0.0) {
+        throw std::runtime_error("Débito alvo inválido");
+    }
+    if (!isSupportedBlockSize(options.blockSize)) {
+        throw std::runtime_error("Tamanho do bloco inválido: " + std::to_string(options.blockSize) +
+                                 " (potências de dois de " + std::to_string(MIN_BLOCK_SIZE) + " a " +
+                                 std::to_string(MAX_BLOCK_SIZE) + ")");
+    }
+
+    // Criar arquivo de saída
+    std::fstream fs;
+    const auto bsHandle = openBitStream(outputFile, false, options.memoryMapped, fs);  // false para modo de escrita
+    if (!bsHandle) {
+        throw std::runtime_error("Erro ao criar arquivo de saída: " + outputFile);
+    }
+    BitStream& bs = *bsHandle;
+
+    // Escrever cabeçalho (formato original, a menos que seja preciso o v2)
+    StreamHeader header;
+    header.quantization = options.quantization.scaled(options.quantizationScale);
+    const bool rateControlled = options.targetKbps > 0.0;
+    header.flags = (options.blockIndex ? FLAG_BLOCK_INDEX : 0) |
+                   (options.coding == CoefficientCoding::Rice ? FLAG_RICE_CODING : 0) |
+                   (options.midSide && channels == 2 ? FLAG_MID_SIDE : 0) |
+                   (header.quantization.isDefault() ? 0 : FLAG_QUANT_TABLE) |
+                   (rateControlled ? FLAG_RATE_CONTROL : 0);
+    header.version = (header.flags & FORMAT_V3_FLAGS) ? FORMAT_VERSION : header.flags != 0 ? 2 : 1;
+    header.sampleRate = sf.samplerate();
+    header.totalFrames = sf.frames();
+    header.blockSize = static_cast<int>(options.blockSize);
+    writeHeader(bs, header);
+
+    std::cout << "Informações do arquivo:\n";
+    std::cout << "Sample rate: " << sf.samplerate() << " Hz\n";
+    std::cout << "Channels: " << sf.channels() << "\n";
+    std::cout << "Frames: " << sf.frames() << "\n";
+    std::cout << "Tamanho do bloco: " << options.blockSize << "\n";
+
+    std::vector<uint64_t> blockOffsets;
+    const int blockCount = withBlockSize(options.blockSize, [&](auto blockSize) {
+        return encodeBlocks<decltype(blockSize)::value>(sf, bs, header, options, blockOffsets);
+    });
+
+    if (options.blockIndex) {
+        writeBlockIndex(bs, blockOffsets);
     }
 
     bs.close();
     std::cout << "Total de blocos processados: " << blockCount << "\n";
 }
 
-void decodeWav(const std::string &inputFile, const std::string &outputWav) {
+void decodeWav(const std::string &inputFile, const std::string &outputWav, const DecoderOptions &options) {
     // Abrir arquivo binário de entrada
-    std::fstream fs(inputFile, std::ios::in | std::ios::binary);
-    if (!fs) {
+    std::fstream fs;
+    const auto bsHandle = openBitStream(inputFile, true, options.memoryMapped, fs);  // true para modo de leitura
+    if (!bsHandle) {
         throw std::runtime_error("Erro ao abrir arquivo de entrada: " + inputFile);
     }
-    fs.seekg(0); // Ir para o início do arquivo para leitura
-    BitStream bs(fs, true);  // true para modo de leitura
+    BitStream& bs = *bsHandle;
 
     std::cout << "\nIniciando decodificação...\n";
     std::cout << "Lendo cabeçalho do arquivo...\n";
 
     // Ler cabeçalho
-    // 1. Sample rate (32 bits)
-    int sampleRate = static_cast<int>(bs.read_n_bits(32));
-    // 2. Número total de frames (32 bits)
-    sf_count_t totalFrames = static_cast<sf_count_t>(bs.read_n_bits(32));
-    // 3. Tamanho do bloco (16 bits)
-    int blockSize = static_cast<int>(bs.read_n_bits(16));
+    const StreamHeader header = readHeader(bs);
+    const int sampleRate = header.sampleRate;
+    const sf_count_t totalFrames = header.totalFrames;
+    const int nCoded = codedChannels(header);
 
     std::cout << "Informações do arquivo:\n";
     std::cout << "Sample rate: " << sampleRate << " Hz\n";
+    std::cout << "Channels: " << nCoded << (nCoded == 2 ? " (mid/side)" : "") << "\n";
     std::cout << "Total frames: " << totalFrames << "\n";
-    std::cout << "Tamanho do bloco: " << blockSize << "\n";
-
-    if (blockSize != BLOCK_SIZE) {
-        throw std::runtime_error("Tamanho do bloco incompatível");
+    std::cout << "Tamanho do bloco: " << header.blockSize << "\n";
+    if (header.flags & FLAG_QUANT_TABLE) {
+        std::cout << "Tabela de quantização: " << header.quantization.steps().size() << " passos\n";
+    }
+    if (header.flags & FLAG_RATE_CONTROL) {
+        std::cout << "Escala de quantização por bloco (débito alvo)\n";
     }
 
     // Criar arquivo WAV de saída
-    SndfileHandle sf(outputWav, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_PCM_16, 1, sampleRate);
+    SndfileHandle sf(outputWav, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_PCM_16, nCoded, sampleRate);
     if (sf.error()) {
         throw std::runtime_error("Erro ao criar arquivo WAV: " + outputWav);
     }
 
-    std::vector<int32_t> quantizedBlock(BLOCK_SIZE);
-    std::vector<double> spectralBlock(BLOCK_SIZE);
-    std::vector<double> timeDomainBlock(BLOCK_SIZE);
-    std::vector<short> pcmBlock(BLOCK_SIZE);
-
     int blockCount = 0;
     sf_count_t totalFramesProcessed = 0;
 
     try {
         std::cout << "\nIniciando leitura dos blocos...\n";
-        while (totalFramesProcessed < totalFrames) {
-            const int framesInBlock = static_cast<int>(bs.read_n_bits(16));
-            if (framesInBlock <= 0 || framesInBlock > static_cast<int>(BLOCK_SIZE)) {
-                throw std::runtime_error("Tamanho de bloco inválido ou corrompido no fluxo codificado");
-            }
-
-            const uint8_t magnitudeBits = static_cast<uint8_t>(bs.read_n_bits(6));
-            if (magnitudeBits > 32) {
-                throw std::runtime_error("Número de bits da magnitude inválido no fluxo codificado");
-            }
-
-            for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
-                const uint64_t signBit = bs.read_n_bits(1);
-                int32_t value = 0;
-
-                if (magnitudeBits > 0) {
-                    const uint64_t magnitude = bs.read_n_bits(magnitudeBits);
-                    if (magnitude > static_cast<uint64_t>(std::numeric_limits<int32_t>::max())) {
-                        throw std::runtime_error("Magnitude de coeficiente excede o intervalo suportado");
-                    }
-
-                    value = signBit ? -static_cast<int32_t>(magnitude)
-                                    : static_cast<int32_t>(magnitude);
-                }
-
-                quantizedBlock[i] = value;
-            }
-
-            spectralBlock = dequantizeDCTCoefficients(quantizedBlock);
-            applyIDCT(spectralBlock, timeDomainBlock);
-
-            for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
-                pcmBlock[i] = clampToInt16(timeDomainBlock[i]);
-            }
-
-            sf.writef(pcmBlock.data(), framesInBlock);
-            totalFramesProcessed += framesInBlock;
-            blockCount++;
-        }
+        totalFramesProcessed = withBlockSize(static_cast<std::size_t>(header.blockSize), [&](auto blockSize) {
+            return decodeBlocks<decltype(blockSize)::value>(bs, header, sf, options, blockCount);
+        });
     } catch (const std::exception& e) {
         std::cout << "Erro durante a leitura: " << e.what() << "\n";
         throw;
@@ -284,3 +1071,45 @@ void decodeWav(const std::string &inputFile, const std::string &outputWav) {
     bs.close();
     std::cout << "Total de blocos decodificados: " << blockCount << "\n";
 }
+
+DecodedAudio decodeRange(const std::string &inputFile, uint64_t startFrame, uint64_t nFrames,
+                         const DecoderOptions &options) {
+    std::fstream fs;
+    const auto bsHandle = openBitStream(inputFile, true, options.memoryMapped, fs);
+    if (!bsHandle) {
+        throw std::runtime_error("Erro ao abrir arquivo de entrada: " + inputFile);
+    }
+    const uint64_t fileSize = static_cast<uint64_t>(std::filesystem::file_size(inputFile));
+    BitStream& bs = *bsHandle;
+
+    const StreamHeader header = readHeader(bs);
+    const uint64_t totalFrames = static_cast<uint64_t>(header.totalFrames);
+    const int nCoded = codedChannels(header);
+
+    DecodedAudio audio;
+    audio.sampleRate = header.sampleRate;
+    audio.channels = nCoded;
+    if (startFrame >= totalFrames || nFrames == 0) {
+        bs.close();
+        return audio;
+    }
+    nFrames = std::min(nFrames, totalFrames - startFrame);
+
+    withBlockSize(static_cast<std::size_t>(header.blockSize), [&](auto blockSize) {
+        decodeRangeBlocks<decltype(blockSize)::value>(bs, header, fileSize, startFrame, nFrames, audio);
+    });
+
+    bs.close();
+    return audio;
+}
+
+void decodeRange(const std::string &inputFile, const std::string &outputWav, uint64_t startFrame, uint64_t nFrames,
+                 const DecoderOptions &options) {
+    const DecodedAudio audio = decodeRange(inputFile, startFrame, nFrames, options);
+
+    SndfileHandle sf(outputWav, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_PCM_16, audio.channels, audio.sampleRate);
+    if (sf.error()) {
+        throw std::runtime_error("Erro ao criar arquivo WAV: " + outputWav);
+    }
+    sf.writef(audio.samples.data(), static_cast<sf_count_t>(audio.samples.size()) / audio.channels);
+}
@@ -1,10 +1,70 @@
 #ifndef DCT_CODEC_H
 #define DCT_CODEC_H
 
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <string>
 
-void encodeWav(const std::string &inputWav, const std::string &outputFile);
-void decodeWav(const std::string &inputFile, const std::string &outputWav);
+#include "quantization.h"
+
+// Codificação dos coeficientes quantizados de cada bloco
+enum class CoefficientCoding {
+    Fixed, // bit de sinal + magnitude com largura fixa por bloco (formato original)
+    Rice   // comprimentos de sequências de zeros + magnitudes, em Golomb-Rice adaptativo
+};
+
+struct EncoderOptions {
+    // Frames por bloco: potência de dois de 64 a 8192, guardada no cabeçalho.
+    // Blocos pequenos reduzem a latência; grandes concentram melhor a energia
+    // em poucos coeficientes (arquivos menores). A tabela de quantização
+    // aplica-se por índice de coeficiente, qualquer que seja o tamanho.
+    std::size_t blockSize = 1024;
+    // nThreads > 1 ativa o modo paralelo (blocos repartidos por threads); o
+    // resultado é idêntico ao do modo sequencial
+    unsigned nThreads = 1;
+    // Acrescenta uma tabela com a posição de cada bloco (formato v2), que
+    // permite decodificar intervalos sem ler o arquivo desde o início
+    bool blockIndex = false;
+    CoefficientCoding coding = CoefficientCoding::Fixed;
+    // Estéreo verdadeiro: codifica os canais mid e side (cada um com a sua largura
+    // de magnitude) em vez da média de L e R; ignorado para arquivos mono
+    bool midSide = false;
+    // Escreve o arquivo de saída pelo backend de memória mapeada do ByteStream
+    bool memoryMapped = false;
+    // Tabela de quantização e escala global dos seus passos (> 1: arquivo menor,
+    // mais ruído); guardadas no cabeçalho (formato v3) se diferirem das originais
+    QuantizationProfile quantization;
+    double quantizationScale = 1.0;
+    // Débito alvo em kbps (0 = desligado): cada bloco usa a escala mais fina
+    // com que cabe na sua parte do débito, pelo que o arquivo não o excede
+    // (exceto se nem a escala mais grossa bastar, p. ex. no modo Fixed, que
+    // gasta pelo menos um bit de sinal por coeficiente)
+    double targetKbps = 0.0;
+};
+
+struct DecoderOptions {
+    // Threads usadas na dequantização e IDCT dos blocos (só em decodeWav)
+    unsigned nThreads = 1;
+    // Lê o arquivo codificado com mmap em vez de std::fstream
+    bool memoryMapped = false;
+};
+
+// Amostras PCM decodificadas (intercaladas por canal)
+struct DecodedAudio {
+    int sampleRate = 0;
+    int channels = 0;
+    std::vector<short> samples;
+};
+
+void encodeWav(const std::string &inputWav, const std::string &outputFile, const EncoderOptions &options = {});
+void decodeWav(const std::string &inputFile, const std::string &outputWav, const DecoderOptions &options = {});
+
+// Decodifica as frames [startFrame, startFrame + nFrames). Com índice de blocos
+// lê apenas os blocos necessários; sem índice percorre o fluxo desde o início.
+DecodedAudio decodeRange(const std::string &inputFile, uint64_t startFrame, uint64_t nFrames,
+                         const DecoderOptions &options = {});
+void decodeRange(const std::string &inputFile, const std::string &outputWav, uint64_t startFrame, uint64_t nFrames,
+                 const DecoderOptions &options = {});
 
 #endif
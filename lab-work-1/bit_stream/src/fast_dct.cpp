@@ -0,0 +1,148 @@
+#include "fast_dct.h"
+
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+// Produto complexo explícito: evita a chamada a __muldc3 (tratamento de NaN/inf)
+// que o operador* de std::complex gera sem -ffast-math.
+inline std::complex<double> multiply(std::complex<double> a, std::complex<double> b) {
+    return {a.real() * b.real() - a.imag() * b.imag(),
+            a.real() * b.imag() + a.imag() * b.real()};
+}
+
+} // namespace
+
+FastDCT::FastDCT(std::size_t size)
+    : m_size(size),
+      m_bitReverse(size),
+      m_roots(size / 2),
+      m_forwardShift(size),
+      m_inverseShift(size),
+      m_work(size) {
+    if (size < 2 || (size & (size - 1)) != 0) {
+        throw std::invalid_argument("O tamanho da DCT tem de ser uma potência de dois (>= 2)");
+    }
+
+    std::size_t log2Size = 0;
+    while ((std::size_t{1} << log2Size) < size) {
+        ++log2Size;
+    }
+    for (std::size_t i = 0; i < size; ++i) {
+        uint32_t reversed = 0;
+        for (std::size_t b = 0; b < log2Size; ++b) {
+            reversed |= static_cast<uint32_t>(((i >> b) & 1U) << (log2Size - 1 - b));
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    const double sizeAsDouble = static_cast<double>(size);
+    for (std::size_t j = 0; j < size / 2; ++j) {
+        m_roots[j] = std::polar(1.0, -2.0 * PI * static_cast<double>(j) / sizeAsDouble);
+    }
+
+    const double dcScale = 1.0 / std::sqrt(sizeAsDouble);
+    const double acScale = std::sqrt(2.0 / sizeAsDouble);
+    for (std::size_t k = 0; k < size; ++k) {
+        const double angle = -PI * static_cast<double>(k) / (2.0 * sizeAsDouble);
+        m_forwardShift[k] = std::polar(k == 0 ? dcScale : acScale, angle);
+        m_inverseShift[k] = std::polar(1.0 / sizeAsDouble, angle);
+    }
+}
+
+// FFT radix-2 in-place sobre m_work (que já deve estar em ordem bit-reversed)
+template <typename Size>
+void FastDCT::fft(Size size) {
+    for (std::size_t length = 2; length <= size; length <<= 1) {
+        const std::size_t half = length / 2;
+        const std::size_t rootStep = size / length;
+
+        for (std::size_t start = 0; start < size; start += length) {
+            for (std::size_t j = 0; j < half; ++j) {
+                const std::complex<double> u = m_work[start + j];
+                const std::complex<double> t = multiply(m_roots[j * rootStep], m_work[start + j + half]);
+                m_work[start + j] = u + t;
+                m_work[start + j + half] = u - t;
+            }
+        }
+    }
+}
+
+template <typename Size>
+void FastDCT::forwardKernel(Size size, const double* input, double* output) {
+    // v[n] = x[2n], v[N - 1 - n] = x[2n + 1]
+    const std::size_t half = size / 2;
+    for (std::size_t n = 0; n < half; ++n) {
+        m_work[m_bitReverse[n]] = {input[2 * n], 0.0};
+        m_work[m_bitReverse[size - 1 - n]] = {input[2 * n + 1], 0.0};
+    }
+
+    fft(size);
+
+    // X[k] = s(k) * Re(exp(-pi i k / 2N) * V[k])
+    for (std::size_t k = 0; k < size; ++k) {
+        output[k] = m_forwardShift[k].real() * m_work[k].real() -
+                    m_forwardShift[k].imag() * m_work[k].imag();
+    }
+}
+
+template <typename Size>
+void FastDCT::inverseKernel(Size size, const double* input, double* output) {
+    // Coeficientes não normalizados: X[k] = c[k] / s(k), com X[N] = 0.
+    // V[k] = exp(pi i k / 2N) * (X[k] - i X[N - k]) e v = IFFT(V), calculada como
+    // conj(FFT(conj(V))) / N; como v é real basta a parte real.
+    const double sizeAsDouble = static_cast<double>(size);
+    const double dcInverse = std::sqrt(sizeAsDouble);
+    const double acInverse = std::sqrt(sizeAsDouble / 2.0);
+
+    m_work[0] = {input[0] * dcInverse * m_inverseShift[0].real(), 0.0};
+    for (std::size_t k = 1; k < size; ++k) {
+        const std::complex<double> conjugated{input[k] * acInverse, input[size - k] * acInverse};
+        m_work[m_bitReverse[k]] = multiply(m_inverseShift[k], conjugated);
+    }
+
+    fft(size);
+
+    const std::size_t half = size / 2;
+    for (std::size_t n = 0; n < half; ++n) {
+        output[2 * n] = m_work[n].real();
+        output[2 * n + 1] = m_work[size - 1 - n].real();
+    }
+}
+
+void FastDCT::forward(std::span<const double> input, std::span<double> output) {
+    forwardKernel(m_size, input.data(), output.data());
+}
+
+void FastDCT::inverse(std::span<const double> input, std::span<double> output) {
+    inverseKernel(m_size, input.data(), output.data());
+}
+
+template <std::size_t N>
+void FixedFastDCT<N>::forward(std::span<const double, N> input, std::span<double, N> output) {
+    m_dct.forwardKernel(std::integral_constant<std::size_t, N>{}, input.data(), output.data());
+}
+
+template <std::size_t N>
+void FixedFastDCT<N>::inverse(std::span<const double, N> input, std::span<double, N> output) {
+    m_dct.inverseKernel(std::integral_constant<std::size_t, N>{}, input.data(), output.data());
+}
+
+// Tamanhos de bloco suportados pelo lossy_codec (dct_codec.cpp)
+template class FixedFastDCT<64>;
+template class FixedFastDCT<128>;
+template class FixedFastDCT<256>;
+template class FixedFastDCT<512>;
+template class FixedFastDCT<1024>;
+template class FixedFastDCT<2048>;
+template class FixedFastDCT<4096>;
+template class FixedFastDCT<8192>;
@@ -0,0 +1,69 @@
+#ifndef FAST_DCT_H
+#define FAST_DCT_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+template <std::size_t N>
+class FixedFastDCT;
+
+// DCT-II / DCT-III ortonormais de tamanho N (potência de dois) em O(N log N),
+// pela reordenação de Makhoul seguida de uma FFT complexa radix-2 de N pontos.
+// Todas as tabelas (twiddles, bit-reversal, rotações) são calculadas no construtor.
+// Cada instância tem o seu próprio buffer de trabalho: usar uma por thread.
+class FastDCT {
+public:
+    explicit FastDCT(std::size_t size);
+
+    std::size_t size() const { return m_size; }
+
+    // output[k] = s(k) * sum_n input[n] * cos(pi * (2n + 1) * k / 2N)
+    void forward(std::span<const double> input, std::span<double> output);
+
+    // Inversa de forward (DCT-III com a mesma normalização)
+    void inverse(std::span<const double> input, std::span<double> output);
+
+private:
+    template <std::size_t N>
+    friend class FixedFastDCT;
+
+    // Núcleos das transformadas: Size é std::size_t (m_size) ou, em
+    // FixedFastDCT, std::integral_constant, com o que todos os ciclos passam a
+    // ter um número de iterações conhecido em compilação
+    template <typename Size>
+    void fft(Size size);
+    template <typename Size>
+    void forwardKernel(Size size, const double* input, double* output);
+    template <typename Size>
+    void inverseKernel(Size size, const double* input, double* output);
+
+    std::size_t m_size;
+    std::vector<uint32_t> m_bitReverse;
+    std::vector<std::complex<double>> m_roots;        // exp(-2 pi i j / N), j < N/2
+    std::vector<std::complex<double>> m_forwardShift; // s(k) * exp(-pi i k / 2N)
+    std::vector<std::complex<double>> m_inverseShift; // exp(-pi i k / 2N) / N
+    std::vector<std::complex<double>> m_work;
+};
+
+// FastDCT de tamanho N fixo em compilação, com as mesmas tabelas e resultados.
+// Instanciada em fast_dct.cpp para os tamanhos de bloco do lossy_codec
+// (potências de dois de 64 a 8192).
+template <std::size_t N>
+class FixedFastDCT {
+public:
+    FixedFastDCT() : m_dct(N) {}
+
+    static constexpr std::size_t size() { return N; }
+
+    void forward(std::span<const double, N> input, std::span<double, N> output);
+    void inverse(std::span<const double, N> input, std::span<double, N> output);
+
+private:
+    FastDCT m_dct;
+};
+
+#endif
@@ -1,24 +1,85 @@
 #include "dct_codec.h"
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 int main(int argc, char *argv[]) {
     try {
-        if (argc != 4 || (argv[1][0] != 'e' && argv[1][0] != 'd')) {
-            std::cerr << "Uso: " << argv[0] << " <e|d> <arquivo_entrada> <arquivo_saida>\n";
+        EncoderOptions options;
+        std::vector<std::string> args;
+        bool validOptions = true;
+        for (int n = 1; n < argc; ++n) {
+            const std::string arg = argv[n];
+            if (arg == "-j" && n + 1 < argc) {
+                // 0 = todos os núcleos; limitado a 4 threads por núcleo (cada uma
+                // tem os seus buffers de trabalho)
+                const int nThreads = std::stoi(argv[++n]);
+                const unsigned nCores = std::max(1U, std::thread::hardware_concurrency());
+                if (nThreads < 0) {
+                    validOptions = false;
+                } else {
+                    options.nThreads = nThreads == 0 ? nCores : std::min(static_cast<unsigned>(nThreads), 4 * nCores);
+                }
+            } else if (arg == "-idx") {
+                options.blockIndex = true;
+            } else if (arg == "-rice") {
+                options.coding = CoefficientCoding::Rice;
+            } else if (arg == "-ms") {
+                options.midSide = true;
+            } else if (arg == "-mmap") {
+                options.memoryMapped = true;
+            } else if (arg == "-qp" && n + 1 < argc) {
+                options.quantization = QuantizationProfile::select(argv[++n]);
+            } else if (arg == "-q" && n + 1 < argc) {
+                options.quantizationScale = std::stod(argv[++n]);
+            } else if (arg == "-kbps" && n + 1 < argc) {
+                options.targetKbps = std::stod(argv[++n]);
+            } else if (arg == "-bs" && n + 1 < argc) {
+                options.blockSize = std::stoul(argv[++n]);
+            } else {
+                args.push_back(arg);
+            }
+        }
+
+        DecoderOptions decoderOptions;
+        decoderOptions.nThreads = options.nThreads;
+        decoderOptions.memoryMapped = options.memoryMapped;
+
+        const char mode = args.empty() ? '\0' : args[0][0];
+        if (!validOptions ||
+            (!((mode == 'e' || mode == 'd') && args.size() == 3) && !(mode == 'r' && args.size() == 5))) {
+            std::cerr << "Uso: " << argv[0] << " [-j N] [-idx] [-rice] [-ms] [-mmap] [-qp perfil] [-q escala] [-kbps alvo] [-bs N] <e|d> <arquivo_entrada> <arquivo_saida>\n";
+            std::cerr << "     " << argv[0] << " [-mmap] r <arquivo_entrada> <arquivo_saida> <frame_inicial> <n_frames>\n";
             std::cerr << "  e: codificar WAV para arquivo comprimido\n";
             std::cerr << "  d: decodificar arquivo comprimido para WAV\n";
+            std::cerr << "  r: decodificar apenas um intervalo de frames para WAV\n";
+            std::cerr << "  -j N: usar N threads (0 = todos os núcleos, máx. 4 por núcleo; def 1)\n";
+            std::cerr << "  -idx: incluir o índice de blocos (acesso aleatório rápido com r)\n";
+            std::cerr << "  -rice: codificar os coeficientes em Golomb-Rice adaptativo\n";
+            std::cerr << "  -ms: manter o estéreo, codificando os canais mid e side\n";
+            std::cerr << "  -mmap: ler/escrever o arquivo comprimido com mmap/pwrite em vez de fstream\n";
+            std::cerr << "  -qp perfil: tabela de quantização (default, flat, gradual ou arquivo com os passos)\n";
+            std::cerr << "  -q escala: multiplicar os passos de quantização (> 1: arquivo menor; def 1)\n";
+            std::cerr << "  -kbps alvo: escolher a escala de cada bloco para não exceder o débito alvo\n";
+            std::cerr << "  -bs N: frames por bloco, potência de dois de 64 a 8192 (def 1024)\n";
             return 1;
         }
 
-        if (argv[1][0] == 'e') {
+        if (mode == 'e') {
             // Modo de codificação
-            encodeWav(argv[2], argv[3]);
-            std::cout << "Arquivo WAV codificado com sucesso para " << argv[3] << std::endl;
-        } else {
+            encodeWav(args[1], args[2], options);
+            std::cout << "Arquivo WAV codificado com sucesso para " << args[2] << std::endl;
+        } else if (mode == 'd') {
             // Modo de decodificação
-            decodeWav(argv[2], argv[3]);
-            std::cout << "Arquivo decodificado com sucesso para " << argv[3] << std::endl;
+            decodeWav(args[1], args[2], decoderOptions);
+            std::cout << "Arquivo decodificado com sucesso para " << args[2] << std::endl;
+        } else {
+            // Modo de decodificação de um intervalo
+            decodeRange(args[1], args[2], std::stoull(args[3]), std::stoull(args[4]), decoderOptions);
+            std::cout << "Intervalo decodificado com sucesso para " << args[2] << std::endl;
         }
     } catch (const std::exception& e) {
         std::cerr << "Erro: " << e.what() << std::endl;
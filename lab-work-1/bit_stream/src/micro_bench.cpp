@@ -0,0 +1,320 @@
+#include "bit_stream.h"
+#include "fast_dct.h"
+#include "micro_bench.h"
+#include "quantization.h"
+#include "uniform_quant.h"
+#include "wav_hist.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t N_VALUES = 1 << 20;  // valores / bytes por iteração dos benchmarks de E/S
+constexpr std::size_t DCT_SIZE = 1024;     // BLOCK_SIZE do lossy_codec
+constexpr std::size_t N_FRAMES = 65536;    // FRAMES_BUFFER_SIZE do wav_hist / wav_quant
+
+const std::string TMP_FILE = "micro_bench.tmp";
+
+std::vector<uint64_t> randomValues(std::size_t n, int width) {
+    std::mt19937_64 rng{12345};
+    const uint64_t mask = width == 64 ? ~uint64_t{0} : (uint64_t{1} << width) - 1;
+    std::vector<uint64_t> values(n);
+    for (auto& value : values) {
+        value = rng() & mask;
+    }
+    return values;
+}
+
+// Áudio sintético: senos com ruído, como amostras de 16 bits intercaladas
+std::vector<short> randomAudio(std::size_t nFrames, int channels) {
+    std::mt19937 rng{12345};
+    std::normal_distribution<double> noise{0.0, 500.0};
+    std::vector<short> samples(nFrames * channels);
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        const double value = 8000.0 * std::sin(static_cast<double>(i / channels) * 0.031) + noise(rng);
+        samples[i] = static_cast<short>(std::clamp(value, -32768.0, 32767.0));
+    }
+    return samples;
+}
+
+// Um bloco mono de randomAudio em double, a entrada da DCT
+std::vector<double> audioBlock(std::size_t n) {
+    const std::vector<short> audio = randomAudio(n, 1);
+    return std::vector<double>(audio.begin(), audio.end());
+}
+
+// Coeficientes da DCT de audioBlock(n), a entrada da quantização e da IDCT
+std::vector<double> dctCoefficients(std::size_t n) {
+    FastDCT dct{n};
+    const std::vector<double> input = audioBlock(n);
+    std::vector<double> coefficients(n);
+    dct.forward(input, coefficients);
+    return coefficients;
+}
+
+// Ciclo interno original do wav_quant (quantização uniforme com reconstrução no
+// meio do intervalo, com uma divisão por amostra), como referência do UniformQuantizer
+void wavQuantLoop(std::vector<short>& samples, int bits) {
+    const int nLevels = 1 << bits;
+    const int step = 65536 / nLevels;
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        int s = samples[i] + 32768;
+        s = (s / step) * step + step / 2;
+        s -= 32768;
+        if (s > 32767) s = 32767;
+        if (s < -32768) s = -32768;
+        samples[i] = static_cast<short>(s);
+    }
+}
+
+void addBitStream(BenchSuite& suite) {
+    for (int width : {1, 8, 13, 32, 57}) {
+        const std::string suffix = std::string("/").append(std::to_string(width));
+
+        suite.add("BitStream::write_n_bits" + suffix, [width](BenchState& state) {
+            const std::vector<uint64_t> values = randomValues(N_VALUES, width);
+            while (state.keepRunning()) {
+                std::fstream fs{TMP_FILE, std::ios::out | std::ios::binary};
+                BitStream bs{fs, STREAM_WRITE};
+                for (uint64_t value : values) {
+                    bs.write_n_bits(value, width);
+                }
+                bs.close();
+            }
+            state.setItemsPerIteration(N_VALUES);
+            state.setBytesPerIteration(N_VALUES * width / 8);
+        });
+
+        suite.add("BitStream::read_n_bits" + suffix, [width](BenchState& state) {
+            {
+                const std::vector<uint64_t> values = randomValues(N_VALUES, width);
+                std::fstream fs{TMP_FILE, std::ios::out | std::ios::binary};
+                BitStream bs{fs, STREAM_WRITE};
+                for (uint64_t value : values) {
+                    bs.write_n_bits(value, width);
+                }
+                bs.close();
+            }
+            while (state.keepRunning()) {
+                std::fstream fs{TMP_FILE, std::ios::in | std::ios::binary};
+                BitStream bs{fs, STREAM_READ};
+                uint64_t sum = 0;
+                for (std::size_t i = 0; i < N_VALUES; ++i) {
+                    sum += bs.read_n_bits(width);
+                }
+                doNotOptimize(sum);
+            }
+            state.setItemsPerIteration(N_VALUES);
+            state.setBytesPerIteration(N_VALUES * width / 8);
+        });
+    }
+}
+
+void addByteStream(BenchSuite& suite) {
+    suite.add("ByteStream::put", [](BenchState& state) {
+        while (state.keepRunning()) {
+            std::fstream fs{TMP_FILE, std::ios::out | std::ios::binary};
+            ByteStream bs{fs, STREAM_WRITE};
+            for (std::size_t i = 0; i < N_VALUES; ++i) {
+                bs.put(static_cast<int>(i & 0xff));
+            }
+            bs.close();
+        }
+        state.setItemsPerIteration(N_VALUES);
+        state.setBytesPerIteration(N_VALUES);
+    });
+
+    suite.add("ByteStream::get", [](BenchState& state) {
+        {
+            std::fstream fs{TMP_FILE, std::ios::out | std::ios::binary};
+            ByteStream bs{fs, STREAM_WRITE};
+            for (std::size_t i = 0; i < N_VALUES; ++i) {
+                bs.put(static_cast<int>(i & 0xff));
+            }
+            bs.close();
+        }
+        while (state.keepRunning()) {
+            std::fstream fs{TMP_FILE, std::ios::in | std::ios::binary};
+            ByteStream bs{fs, STREAM_READ};
+            int sum = 0;
+            for (std::size_t i = 0; i < N_VALUES; ++i) {
+                sum += bs.get();
+            }
+            doNotOptimize(sum);
+        }
+        state.setItemsPerIteration(N_VALUES);
+        state.setBytesPerIteration(N_VALUES);
+    });
+}
+
+void addTransforms(BenchSuite& suite) {
+    suite.add("FastDCT::forward/1024", [](BenchState& state) {
+        FastDCT dct{DCT_SIZE};
+        const std::vector<double> input = audioBlock(DCT_SIZE);
+        std::vector<double> output(DCT_SIZE);
+        while (state.keepRunning()) {
+            dct.forward(input, output);
+            doNotOptimize(output[0]);
+        }
+        state.setBytesPerIteration(DCT_SIZE * sizeof(double));
+    });
+
+    suite.add("FastDCT::inverse/1024", [](BenchState& state) {
+        FastDCT dct{DCT_SIZE};
+        const std::vector<double> coefficients = dctCoefficients(DCT_SIZE);
+        std::vector<double> output(DCT_SIZE);
+        while (state.keepRunning()) {
+            dct.inverse(coefficients, output);
+            doNotOptimize(output[0]);
+        }
+        state.setBytesPerIteration(DCT_SIZE * sizeof(double));
+    });
+
+    suite.add("quantizeDCTCoefficients/1024", [](BenchState& state) {
+        const std::vector<double> coefficients = dctCoefficients(DCT_SIZE);
+        while (state.keepRunning()) {
+            std::vector<int32_t> quantized = quantizeDCTCoefficients(coefficients);
+            doNotOptimize(quantized[0]);
+        }
+        state.setItemsPerIteration(DCT_SIZE);
+        state.setBytesPerIteration(DCT_SIZE * sizeof(double));
+    });
+
+    suite.add("dequantizeDCTCoefficients/1024", [](BenchState& state) {
+        const std::vector<int32_t> quantized = quantizeDCTCoefficients(dctCoefficients(DCT_SIZE));
+        while (state.keepRunning()) {
+            std::vector<double> dequantized = dequantizeDCTCoefficients(quantized);
+            doNotOptimize(dequantized[0]);
+        }
+        state.setItemsPerIteration(DCT_SIZE);
+        state.setBytesPerIteration(DCT_SIZE * sizeof(int32_t));
+    });
+
+    // Versões sobre buffers do chamador, as usadas pelo codec
+    suite.add("quantizeDCTCoefficients/span/1024", [](BenchState& state) {
+        const std::vector<double> coefficients = dctCoefficients(DCT_SIZE);
+        std::vector<int32_t> quantized(DCT_SIZE);
+        while (state.keepRunning()) {
+            quantizeDCTCoefficients(coefficients, quantized);
+            doNotOptimize(quantized[0]);
+        }
+        state.setItemsPerIteration(DCT_SIZE);
+        state.setBytesPerIteration(DCT_SIZE * sizeof(double));
+    });
+
+    suite.add("dequantizeDCTCoefficients/span/1024", [](BenchState& state) {
+        const std::vector<int32_t> quantized = quantizeDCTCoefficients(dctCoefficients(DCT_SIZE));
+        std::vector<double> dequantized(DCT_SIZE);
+        while (state.keepRunning()) {
+            dequantizeDCTCoefficients(quantized, dequantized);
+            doNotOptimize(dequantized[0]);
+        }
+        state.setItemsPerIteration(DCT_SIZE);
+        state.setBytesPerIteration(DCT_SIZE * sizeof(int32_t));
+    });
+}
+
+void addSamples(BenchSuite& suite) {
+    for (int channels : {1, 2}) {
+        suite.add("WAVHist::update/" + std::string(channels == 1 ? "mono" : "stereo"), [channels](BenchState& state) {
+            const std::vector<short> samples = randomAudio(N_FRAMES, channels);
+            WAVHist hist{channels};
+            while (state.keepRunning()) {
+                hist.update(samples);
+            }
+            state.setItemsPerIteration(N_FRAMES);
+            state.setBytesPerIteration(samples.size() * sizeof(short));
+        });
+    }
+
+    for (int bits : {4, 8, 12}) {
+        suite.add("wav_quant division loop/" + std::to_string(bits), [bits](BenchState& state) {
+            const std::vector<short> audio = randomAudio(N_FRAMES, 2);
+            std::vector<short> samples(audio.size());
+            while (state.keepRunning()) {
+                std::copy(audio.begin(), audio.end(), samples.begin());
+                wavQuantLoop(samples, bits);
+                doNotOptimize(samples[0]);
+            }
+            state.setItemsPerIteration(samples.size());
+            state.setBytesPerIteration(samples.size() * sizeof(short));
+        });
+    }
+
+    // Núcleos do UniformQuantizer (8 bits), em cada modo, com e sem dither
+    struct Kernel {
+        const char* name;
+        QuantKernel kernel;
+    };
+    std::vector<Kernel> kernels{{"scalar", &quantKernelScalar}};
+#ifdef UNIFORM_QUANT_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.push_back({"sse2", &quantKernelSse2});
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.push_back({"avx2", &quantKernelAvx2});
+    }
+#endif
+    for (const Kernel& kernel : kernels) {
+        for (const bool tread : {false, true}) {
+            for (const bool dither : {false, true}) {
+                const std::string name = std::string("UniformQuantizer/") + (tread ? "tread" : "rise") +
+                                         (dither ? "+dither/" : "/") + kernel.name;
+                suite.add(name, [kernel, tread, dither](BenchState& state) {
+                    const std::vector<short> audio = randomAudio(N_FRAMES, 2);
+                    std::vector<short> samples(audio.size());
+                    UniformQuantizer quantizer{8, tread ? QuantMode::MidTread : QuantMode::MidRise, dither, 1,
+                                               kernel.kernel};
+                    while (state.keepRunning()) {
+                        std::copy(audio.begin(), audio.end(), samples.begin());
+                        quantizer.quantize(samples.data(), samples.size());
+                        doNotOptimize(samples[0]);
+                    }
+                    state.setItemsPerIteration(samples.size());
+                    state.setBytesPerIteration(samples.size() * sizeof(short));
+                });
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    double minTime = 0.2;
+    int repetitions = 5;
+
+    for (int n = 1; n < argc; ++n) {
+        const std::string arg = argv[n];
+        if (arg == "-filter" && n + 1 < argc) {
+            filter = argv[++n];
+        } else if (arg == "-min_time" && n + 1 < argc) {
+            minTime = std::stod(argv[++n]);
+        } else if (arg == "-reps" && n + 1 < argc) {
+            repetitions = std::max(1, std::stoi(argv[++n]));
+        } else {
+            std::cerr << "Usage: micro_bench [ -filter substring ] [ -min_time seconds (def 0.2) ] [ -reps n (def 5) ]\n";
+            return 1;
+        }
+    }
+
+    BenchSuite suite;
+    addBitStream(suite);
+    addByteStream(suite);
+    addTransforms(suite);
+    addSamples(suite);
+    suite.run(filter, minTime, repetitions);
+
+    std::remove(TMP_FILE.c_str());
+    return 0;
+}
@@ -0,0 +1,121 @@
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Microbenchmarks no estilo do Google Benchmark, sem dependências:
+//
+//     suite.add("nome", [](BenchState& state) {
+//         // preparação (não medida)
+//         while (state.keepRunning()) { /* operação */ }
+//         state.setItemsPerIteration(n);
+//         state.setBytesPerIteration(b);
+//     });
+//
+// O número de iterações é calibrado até uma execução durar pelo menos minTime
+// segundos; a medição é repetida e reportada a mediana (e o intervalo) em ns
+// por item e bytes/s, para resultados comparáveis entre execuções.
+class BenchState {
+public:
+    explicit BenchState(std::size_t iterations) : m_remaining(iterations), m_iterations(iterations) {}
+
+    bool keepRunning() {
+        if (m_remaining == m_iterations) {
+            m_start = std::chrono::steady_clock::now();
+        }
+        if (m_remaining-- > 0) {
+            return true;
+        }
+        m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        return false;
+    }
+
+    // Itens (operações) e bytes processados por iteração do ciclo
+    void setItemsPerIteration(std::size_t items) { m_items = items; }
+    void setBytesPerIteration(std::size_t bytes) { m_bytes = bytes; }
+
+    std::size_t iterations() const { return m_iterations; }
+    std::size_t items() const { return m_items; }
+    std::size_t bytes() const { return m_bytes; }
+    double seconds() const { return m_seconds; }
+
+private:
+    std::size_t m_remaining;
+    std::size_t m_iterations;
+    std::size_t m_items = 1;
+    std::size_t m_bytes = 0;
+    double m_seconds = 0.0;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+// Impede que o compilador elimine um resultado não usado
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class BenchSuite {
+public:
+    using Function = std::function<void(BenchState&)>;
+
+    void add(const std::string& name, Function function) { m_benchmarks.push_back({name, std::move(function)}); }
+
+    // Corre os benchmarks cujo nome contém filter
+    void run(const std::string& filter, double minTime, int repetitions) const {
+        std::printf("%-34s %12s %12s %16s %12s\n", "benchmark", "iterations", "ns/item", "range", "MB/s");
+        for (const auto& benchmark : m_benchmarks) {
+            if (benchmark.name.find(filter) == std::string::npos) {
+                continue;
+            }
+
+            // Calibração: duplicar as iterações até a execução durar minTime
+            std::size_t iterations = 1;
+            for (;;) {
+                BenchState state{iterations};
+                benchmark.function(state);
+                if (state.seconds() >= minTime || iterations >= (std::size_t{1} << 40)) {
+                    break;
+                }
+                const double scale = state.seconds() > 0.0 ? minTime / state.seconds() * 1.2 : 10.0;
+                iterations = std::max(iterations * 2, static_cast<std::size_t>(iterations * std::min(scale, 10.0)));
+            }
+
+            std::vector<double> nsPerItem;
+            double bytesPerItem = 0.0;
+            for (int r = 0; r < repetitions; ++r) {
+                BenchState state{iterations};
+                benchmark.function(state);
+                const double items = static_cast<double>(state.iterations()) * static_cast<double>(state.items());
+                nsPerItem.push_back(state.seconds() * 1e9 / items);
+                bytesPerItem = static_cast<double>(state.bytes()) / static_cast<double>(state.items());
+            }
+            std::sort(nsPerItem.begin(), nsPerItem.end());
+            const double median = nsPerItem[nsPerItem.size() / 2];
+
+            char range[32];
+            std::snprintf(range, sizeof range, "%.2f-%.2f", nsPerItem.front(), nsPerItem.back());
+            std::printf("%-34s %12zu %12.2f %16s ", benchmark.name.c_str(), iterations, median, range);
+            if (bytesPerItem > 0.0) {
+                std::printf("%12.1f\n", bytesPerItem / median * 1e9 / 1e6);
+            } else {
+                std::printf("%12s\n", "-");
+            }
+        }
+    }
+
+private:
+    struct Benchmark {
+        std::string name;
+        Function function;
+    };
+
+    std::vector<Benchmark> m_benchmarks;
+};
+
+#endif
@@ -1,49 +1,225 @@
 #include "quantization.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
 #include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 
+namespace {
+
 // Tabela simples de fatores de quantização para os primeiros coeficientes.
 // Os restantes usam o último valor.
-const std::vector<double> kQuantizationTable = {
+constexpr std::array<double, 16> kQuantizationTable = {
     4.0,   4.0,   8.0,    8.0,    16.0,   16.0,   32.0,   32.0,
     64.0,  64.0,  128.0,  128.0,  256.0,  256.0,  512.0,  512.0
 };
 
-double quantization_step_for_index(std::size_t idx) {
-    return (idx < kQuantizationTable.size())
-               ? kQuantizationTable[idx]
-               : kQuantizationTable.back();
+// Perfil "flat": o mesmo passo em todos os coeficientes
+constexpr double kFlatStep = 64.0;
+
+// Perfil "gradual": passos em progressão geométrica de 4 a 512 ao longo dos
+// primeiros 64 coeficientes, em vez de duplicarem a cada dois
+constexpr std::size_t kGradualSteps = 64;
+
+// Arredondamento (metades para longe do zero, como llround) e saturação em
+// int32, sem saltos nem chamadas à libm: o valor é saturado e truncado, e a
+// parte fracionária f (exata, porque |value| < 2^31) soma trunc(2f), que é
+// +-1 só quando |f| >= 0.5. Com -fno-trapping-math (CMakeLists.txt) o
+// compilador vetoriza os ciclos mesmo só com SSE2.
+inline int32_t roundToInt32(double value) {
+    constexpr double minValue = static_cast<double>(std::numeric_limits<int32_t>::min());
+    constexpr double maxValue = static_cast<double>(std::numeric_limits<int32_t>::max());
+
+    const double clamped = std::min(std::max(value, minValue), maxValue);
+    const int32_t truncated = static_cast<int32_t>(clamped);
+    const double fraction = clamped - static_cast<double>(truncated);
+    return truncated + static_cast<int32_t>(fraction + fraction);
 }
 
+} // namespace
 
-std::vector<int32_t> quantizeDCTCoefficients(const std::vector<double>& dctCoefficients) {
-    std::vector<int32_t> quantizedCoefficients(dctCoefficients.size());
+QuantizationProfile::QuantizationProfile()
+    : QuantizationProfile(std::vector<double>(kQuantizationTable.begin(), kQuantizationTable.end())) {}
 
-    for (std::size_t i = 0; i < dctCoefficients.size(); ++i) {
-        const double step = quantization_step_for_index(i);
-        const long long rawValue = std::llround(dctCoefficients[i] / step);
-        const long long clamped = std::clamp(
-            rawValue,
-            static_cast<long long>(std::numeric_limits<int32_t>::min()),
-            static_cast<long long>(std::numeric_limits<int32_t>::max()));
-        quantizedCoefficients[i] = static_cast<int32_t>(clamped);
+QuantizationProfile::QuantizationProfile(std::vector<double> steps) : m_steps(std::move(steps)) {
+    if (m_steps.empty() || m_steps.size() > MAX_STEPS) {
+        throw std::invalid_argument("A tabela de quantização deve ter entre 1 e " + std::to_string(MAX_STEPS) +
+                                    " passos");
+    }
+    // Os inversos servem para multiplicar em vez de dividir; com passos
+    // potências de dois (como os da tabela original) o resultado é exatamente
+    // o da divisão, com outros pode diferir no último bit
+    m_inverseSteps.reserve(m_steps.size());
+    for (const double step : m_steps) {
+        if (!std::isfinite(step) || step <= 0.0) {
+            throw std::invalid_argument("Passo de quantização inválido: " + std::to_string(step));
+        }
+        m_inverseSteps.push_back(1.0 / step);
     }
+}
 
-    return quantizedCoefficients;
+QuantizationProfile QuantizationProfile::select(const std::string& nameOrPath) {
+    if (nameOrPath == "default") {
+        return QuantizationProfile();
+    }
+    if (nameOrPath == "flat") {
+        return QuantizationProfile(std::vector<double>{kFlatStep});
+    }
+    if (nameOrPath == "gradual") {
+        std::vector<double> steps(kGradualSteps);
+        for (std::size_t i = 0; i < kGradualSteps; ++i) {
+            steps[i] = kQuantizationTable.front() *
+                       std::exp2(7.0 * static_cast<double>(i) / static_cast<double>(kGradualSteps - 1));
+        }
+        return QuantizationProfile(std::move(steps));
+    }
+    return load(nameOrPath);
 }
 
-std::vector<double> dequantizeDCTCoefficients(const std::vector<int32_t>& quantizedCoefficients) {
-    std::vector<double> dequantizedCoefficients(quantizedCoefficients.size());
+QuantizationProfile QuantizationProfile::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Perfil de quantização desconhecido ou arquivo inexistente: " + path);
+    }
 
-    for (std::size_t i = 0; i < quantizedCoefficients.size(); ++i) {
-        const double step = quantization_step_for_index(i);
-        dequantizedCoefficients[i] = static_cast<double>(quantizedCoefficients[i]) * step;
+    std::vector<double> steps;
+    std::string token;
+    while (file >> token) {
+        if (token[0] == '#') {
+            std::getline(file, token);
+            continue;
+        }
+        try {
+            std::size_t used = 0;
+            steps.push_back(std::stod(token, &used));
+            if (used != token.size()) {
+                throw std::invalid_argument(token);
+            }
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("Valor inválido no arquivo de quantização " + path + ": " + token);
+        }
     }
+    return QuantizationProfile(std::move(steps));
+}
 
-    return dequantizedCoefficients;
+QuantizationProfile QuantizationProfile::scaled(double scale) const {
+    std::vector<double> steps(m_steps);
+    for (double& step : steps) {
+        step *= scale;
+    }
+    return QuantizationProfile(std::move(steps));
+}
+
+bool QuantizationProfile::isDefault() const {
+    return std::equal(m_steps.begin(), m_steps.end(), kQuantizationTable.begin(), kQuantizationTable.end());
+}
+
+namespace {
+
+// Os coeficientes com passo próprio e depois os restantes, com o último passo:
+// dois ciclos de multiplicação-arredondamento-saturação vetorizáveis. Com
+// scale = 1 os inversos ficam inalterados, e o resultado é o da tabela. Size é
+// std::size_t ou, nas versões por bloco, std::integral_constant.
+template <typename Size>
+void quantizeKernel(Size size, const double* dctCoefficients, int32_t* quantizedCoefficients,
+                    const QuantizationProfile& profile, double scale) {
+    const std::vector<double>& inverseSteps = profile.inverseSteps();
+    const double inverseScale = 1.0 / scale;
+    const std::size_t head = std::min<std::size_t>(size, inverseSteps.size());
+
+    for (std::size_t i = 0; i < head; ++i) {
+        quantizedCoefficients[i] = roundToInt32(dctCoefficients[i] * (inverseSteps[i] * inverseScale));
+    }
+
+    const double inverseStep = inverseSteps.back() * inverseScale;
+    for (std::size_t i = head; i < size; ++i) {
+        quantizedCoefficients[i] = roundToInt32(dctCoefficients[i] * inverseStep);
+    }
+}
+
+template <typename Size>
+void dequantizeKernel(Size size, const int32_t* quantizedCoefficients, double* dctCoefficients,
+                      const QuantizationProfile& profile, double scale) {
+    const std::vector<double>& steps = profile.steps();
+    const std::size_t head = std::min<std::size_t>(size, steps.size());
+
+    for (std::size_t i = 0; i < head; ++i) {
+        dctCoefficients[i] = static_cast<double>(quantizedCoefficients[i]) * (steps[i] * scale);
+    }
+
+    const double step = steps.back() * scale;
+    for (std::size_t i = head; i < size; ++i) {
+        dctCoefficients[i] = static_cast<double>(quantizedCoefficients[i]) * step;
+    }
+}
+
+} // namespace
+
+void quantizeDCTCoefficients(std::span<const double> dctCoefficients, std::span<int32_t> quantizedCoefficients,
+                             const QuantizationProfile& profile, double scale) {
+    quantizeKernel(dctCoefficients.size(), dctCoefficients.data(), quantizedCoefficients.data(), profile, scale);
+}
+
+void dequantizeDCTCoefficients(std::span<const int32_t> quantizedCoefficients, std::span<double> dctCoefficients,
+                               const QuantizationProfile& profile, double scale) {
+    dequantizeKernel(quantizedCoefficients.size(), quantizedCoefficients.data(), dctCoefficients.data(), profile,
+                     scale);
+}
+
+template <std::size_t N>
+void quantizeDCTBlock(std::span<const double, N> dctCoefficients, std::span<int32_t, N> quantizedCoefficients,
+                      const QuantizationProfile& profile, double scale) {
+    quantizeKernel(std::integral_constant<std::size_t, N>{}, dctCoefficients.data(), quantizedCoefficients.data(),
+                   profile, scale);
+}
+
+template <std::size_t N>
+void dequantizeDCTBlock(std::span<const int32_t, N> quantizedCoefficients, std::span<double, N> dctCoefficients,
+                        const QuantizationProfile& profile, double scale) {
+    dequantizeKernel(std::integral_constant<std::size_t, N>{}, quantizedCoefficients.data(), dctCoefficients.data(),
+                     profile, scale);
 }
 
+// Tamanhos de bloco suportados pelo lossy_codec (dct_codec.cpp)
+#define INSTANTIATE_DCT_BLOCK(N)                                                                               \
+    template void quantizeDCTBlock<N>(std::span<const double, N>, std::span<int32_t, N>,                      \
+                                      const QuantizationProfile&, double);                                    \
+    template void dequantizeDCTBlock<N>(std::span<const int32_t, N>, std::span<double, N>,                    \
+                                        const QuantizationProfile&, double);
+INSTANTIATE_DCT_BLOCK(64)
+INSTANTIATE_DCT_BLOCK(128)
+INSTANTIATE_DCT_BLOCK(256)
+INSTANTIATE_DCT_BLOCK(512)
+INSTANTIATE_DCT_BLOCK(1024)
+INSTANTIATE_DCT_BLOCK(2048)
+INSTANTIATE_DCT_BLOCK(4096)
+INSTANTIATE_DCT_BLOCK(8192)
+#undef INSTANTIATE_DCT_BLOCK
+
+void quantizeDCTCoefficients(std::span<const double> dctCoefficients, std::span<int32_t> quantizedCoefficients) {
+    static const QuantizationProfile defaultProfile;
+    quantizeDCTCoefficients(dctCoefficients, quantizedCoefficients, defaultProfile);
+}
+
+void dequantizeDCTCoefficients(std::span<const int32_t> quantizedCoefficients, std::span<double> dctCoefficients) {
+    static const QuantizationProfile defaultProfile;
+    dequantizeDCTCoefficients(quantizedCoefficients, dctCoefficients, defaultProfile);
+}
+
+std::vector<int32_t> quantizeDCTCoefficients(const std::vector<double>& dctCoefficients) {
+    std::vector<int32_t> quantizedCoefficients(dctCoefficients.size());
+    quantizeDCTCoefficients(std::span<const double>(dctCoefficients), std::span<int32_t>(quantizedCoefficients));
+    return quantizedCoefficients;
+}
+
+std::vector<double> dequantizeDCTCoefficients(const std::vector<int32_t>& quantizedCoefficients) {
+    std::vector<double> dequantizedCoefficients(quantizedCoefficients.size());
+    dequantizeDCTCoefficients(std::span<const int32_t>(quantizedCoefficients), std::span<double>(dequantizedCoefficients));
+    return dequantizedCoefficients;
+}
@@ -1,13 +1,68 @@
 #ifndef QUANTIZATION_H
 #define QUANTIZATION_H
 
+#include <cstddef>
 #include <cstdint>
+#include <span>
+#include <string>
 #include <vector>
 
+// Tabela de passos de quantização dos coeficientes DCT: os primeiros
+// steps().size() coeficientes têm passo próprio e os restantes usam o último.
+// A tabela por omissão é a original do codec (16 passos, de 4 a 512).
+class QuantizationProfile {
+public:
+    // Um passo por coeficiente do maior bloco do codec, no máximo
+    static constexpr std::size_t MAX_STEPS = 8192;
+
+    QuantizationProfile();
+    // Passos positivos e finitos; lança std::invalid_argument caso contrário
+    explicit QuantizationProfile(std::vector<double> steps);
+
+    // Perfil predefinido ("default", "flat" ou "gradual") ou, se o nome não for
+    // de nenhum, lido de um arquivo de texto com os passos separados por espaços
+    // ou mudanças de linha (# inicia um comentário até ao fim da linha)
+    static QuantizationProfile select(const std::string& nameOrPath);
+    static QuantizationProfile load(const std::string& path);
+
+    // A mesma tabela com todos os passos multiplicados por scale (> 1: menos
+    // bits e mais ruído)
+    QuantizationProfile scaled(double scale) const;
+
+    bool isDefault() const;
+    const std::vector<double>& steps() const { return m_steps; }
+    const std::vector<double>& inverseSteps() const { return m_inverseSteps; }
+
+private:
+    std::vector<double> m_steps;
+    std::vector<double> m_inverseSteps;
+};
+
 // Quantização dos coeficientes DCT
 std::vector<int32_t> quantizeDCTCoefficients(const std::vector<double>& dctCoefficients);
 
 // Dequantização dos coeficientes DCT
 std::vector<double> dequantizeDCTCoefficients(const std::vector<int32_t>& quantizedCoefficients);
 
+// Versões sem alocação, sobre buffers do chamador (do mesmo tamanho); são as
+// usadas pelo codec, um bloco de cada vez
+void quantizeDCTCoefficients(std::span<const double> dctCoefficients, std::span<int32_t> quantizedCoefficients);
+void dequantizeDCTCoefficients(std::span<const int32_t> quantizedCoefficients, std::span<double> dctCoefficients);
+
+// Com uma tabela qualquer, e os passos multiplicados por scale (a escala de
+// cada bloco no modo de débito alvo)
+void quantizeDCTCoefficients(std::span<const double> dctCoefficients, std::span<int32_t> quantizedCoefficients,
+                             const QuantizationProfile& profile, double scale = 1.0);
+void dequantizeDCTCoefficients(std::span<const int32_t> quantizedCoefficients, std::span<double> dctCoefficients,
+                               const QuantizationProfile& profile, double scale = 1.0);
+
+// O mesmo para um bloco de N coeficientes, com N fixo em compilação (instanciadas
+// em quantization.cpp para os tamanhos de bloco do lossy_codec, 64 a 8192)
+template <std::size_t N>
+void quantizeDCTBlock(std::span<const double, N> dctCoefficients, std::span<int32_t, N> quantizedCoefficients,
+                      const QuantizationProfile& profile, double scale = 1.0);
+template <std::size_t N>
+void dequantizeDCTBlock(std::span<const int32_t, N> quantizedCoefficients, std::span<double, N> dctCoefficients,
+                        const QuantizationProfile& profile, double scale = 1.0);
+
 #endif
@@ -1,68 +1,113 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <stdexcept>
 #include <sndfile.hh>
 #include <cmath>
+#include <cstdint>
+#include <filesystem>
 
 #include "bit_stream.h"
+#include "uniform_quant.h"
 
 using namespace std;
 
 constexpr size_t FRAMES_BUFFER_SIZE = 65536; // buffer frames
+constexpr int MAX_CHANNELS = 1024;           // libsndfile's own channel limit
+constexpr uint64_t HEADER_BITS = 8 + 8 + 16 + 32 + 32;
 
+// Decoding of a file written by wav2bin: the header gives the format of the
+// WAV file and each index is replaced by the level of its quantizer
 int main(int argc, char* argv[]) {
-      // argument handling
-    if(argc < 3) {
-        cerr << "Usage: bin2wav <input.wav> <encoded_file> <bits> \n";
+    // argument handling
+    // "-mmap" reads the encoded file through the memory-mapped ByteStream backend
+    bool useMmap = argc > 1 && string(argv[1]) == "-mmap";
+    if(useMmap) {
+        argv++;
+        argc--;
+    }
+
+    if(argc != 3) {
+        cerr << "Usage: bin2wav [-mmap] <encoded_file> <output.wav>\n";
         return 1;
     }
 
     string inFile  = argv[1];
     string outFile = argv[2];
-    int bits = stoi(argv[3]);
-
-    if(bits <= 0 || bits > 16) {
-        cerr << "Error: bits must be between 1 and 16\n";
-        return 1;
-    }
 
     // file input handler
-    fstream ifs { inFile, ios::in | ios::binary };
-    if(not ifs.is_open()) {
+    fstream ifs;
+    unique_ptr<BitStream> ibsHandle;
+    if(useMmap)
+      ibsHandle = make_unique<BitStream>(inFile, STREAM_READ);
+    else {
+      ifs.open(inFile, ios::in | ios::binary);
+      ibsHandle = make_unique<BitStream>(ifs, STREAM_READ);
+    }
+    if(not ibsHandle->is_open()) {
       cerr << "Error opening bin file " << inFile << endl;
       return 1;
     }
+    BitStream& ibs = *ibsHandle;
 
-    // audio file input handler
-    SndfileHandle sfhIn { outFile };
-    if(sfhIn.error() || (sfhIn.format() & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_16) {
-        cerr << "Error: invalid input WAV file (must be PCM_16)\n";
+    // header
+    int bits, tread, channels, sampleRate;
+    sf_count_t frames;
+    try {
+        bits = static_cast<int>(ibs.read_n_bits(8));
+        tread = static_cast<int>(ibs.read_n_bits(8));
+        channels = static_cast<int>(ibs.read_n_bits(16));
+        sampleRate = static_cast<int>(ibs.read_n_bits(32));
+        frames = static_cast<sf_count_t>(ibs.read_n_bits(32));
+    } catch(const runtime_error&) {
+        cerr << "Error: " << inFile << " is too short to hold a header\n";
+        return 1;
+    }
+
+    if(bits <= 0 || bits > 16 || tread > 1 || channels == 0 || channels > MAX_CHANNELS || sampleRate == 0) {
+        cerr << "Error: invalid header in " << inFile << "\n";
+        return 1;
+    }
+
+    // the payload must hold every index announced by the header, otherwise
+    // the file is truncated and decoding would stop halfway through the WAV
+    error_code ec;
+    uint64_t fileBits = filesystem::file_size(inFile, ec) * 8;
+    uint64_t payloadBits = static_cast<uint64_t>(frames) * channels * bits;
+    if(ec || fileBits < HEADER_BITS + payloadBits) {
+        cerr << "Error: " << inFile << " is truncated (expected "
+             << (HEADER_BITS + payloadBits + 7) / 8 << " bytes)\n";
         return 1;
     }
 
     // file output handler
-    SndfileHandle sfhOut { outFile, SFM_WRITE, sfhIn.format(), sfhIn.channels(), sfhIn.samplerate() };
+    SndfileHandle sfhOut { outFile, SFM_WRITE, SF_FORMAT_WAV | SF_FORMAT_PCM_16, channels, sampleRate };
     if(sfhOut.error()) {
-        cerr << "Error: cannot create output file\n" << sfhOut.error();
+        cerr << "Error: cannot create output file\n";
         return 1;
     }
     
-	  BitStream ibs { ifs, STREAM_READ };
-    // vector<short> samples(FRAMES_BUFFER_SIZE * nChannels);
-    vector<short> samples(FRAMES_BUFFER_SIZE);
+    UniformQuantizer quantizer { bits, tread ? QuantMode::MidTread : QuantMode::MidRise };
+    vector<short> samples(FRAMES_BUFFER_SIZE * channels);
 
-    int c;
-    int i = 0;
-    while ((c = ibs.read_n_bits(bits)) != EOF)
-    {
-      samples[i] = c;
-      sfhOut.write(&c, i);
-      i++;
+    try {
+        while(frames > 0) {
+            size_t nFrames = static_cast<size_t>(min<sf_count_t>(frames, FRAMES_BUFFER_SIZE));
+            for(size_t i = 0; i < nFrames * channels; ++i)
+                samples[i] = quantizer.level(static_cast<uint16_t>(ibs.read_n_bits(bits)));
+            sfhOut.writef(samples.data(), nFrames);
+            frames -= nFrames;
+        }
+    } catch(const runtime_error& e) {
+        // the size check above makes this unlikely (e.g. the file shrank while
+        // being read); don't leave a partial WAV behind
+        cerr << "Error: " << e.what() << " in " << inFile << "\n";
+        sfhOut = SndfileHandle();
+        filesystem::remove(outFile, ec);
+        return 1;
     }
 
-    sfhOut.writef(samples.data(), i);
-
     cout << "Decodification complete: " << bits << " bits of resolution used.\n";
     return 0;
 }
-
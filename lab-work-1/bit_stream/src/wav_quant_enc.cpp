@@ -5,22 +5,39 @@
 #include <cmath>
 
 #include "bit_stream.h"
+#include "uniform_quant.h"
 
 using namespace std;
 
 constexpr size_t FRAMES_BUFFER_SIZE = 65536; // buffer frames
 
-// Binary encoding of the provided audio file
+// Binary encoding of the provided audio file: a header (bits, quantizer mode,
+// channels, sample rate and frames) followed by the index of the level of
+// each sample, in `bits` bits
 int main(int argc, char* argv[]) {
     // argument handling
-    if(argc < 4) {
-        cerr << "Usage: wav2bin <input.wav> <encoded_file> <bits>\n";
+    QuantMode mode = QuantMode::MidRise;
+    bool dither = false;
+    int n = 1;
+    for(; n < argc && argv[n][0] == '-'; ++n) {
+        if(string(argv[n]) == "-tread")
+            mode = QuantMode::MidTread;
+        else if(string(argv[n]) == "-dither")
+            dither = true;
+        else
+            break;
+    }
+
+    if(argc - n != 3) {
+        cerr << "Usage: wav2bin [-tread] [-dither] <input.wav> <encoded_file> <bits>\n";
+        cerr << "  -tread: mid-tread quantizer instead of mid-rise (see wav_quant)\n";
+        cerr << "  -dither: add triangular noise of up to one step before quantizing\n";
         return 1;
     }
 
-    string inFile  = argv[1];
-    string outFile = argv[2];
-    int bits = stoi(argv[3]);
+    string inFile  = argv[n];
+    string outFile = argv[n + 1];
+    int bits = stoi(argv[n + 2]);
 
     if(bits <= 0 || bits > 16) {
         cerr << "Error: bits must be between 1 and 16\n";
@@ -35,7 +52,7 @@ int main(int argc, char* argv[]) {
     }
     
     // file output handler
-    fstream ofs { outFile };
+    fstream ofs { outFile, ios::out | ios::binary };
     if(not ofs.is_open()) {
         cerr << "Error opening bin file " << outFile << endl;
         return 1;
@@ -43,26 +60,25 @@ int main(int argc, char* argv[]) {
     
     BitStream obs { ofs, STREAM_WRITE };
 
-    // Quantization parameters
-    int nLevels = 1 << bits; // number of levels for resolution
-    int step = 65536 / nLevels; // resolution step size
-    
+    // header: format, channels and samplerate
+    obs.write_n_bits(bits, 8);
+    obs.write_n_bits(mode == QuantMode::MidTread ? 1 : 0, 8);
+    obs.write_n_bits(sfhIn.channels(), 16);
+    obs.write_n_bits(sfhIn.samplerate(), 32);
+    obs.write_n_bits(sfhIn.frames(), 32);
+
+    UniformQuantizer quantizer { bits, mode, dither };
     vector<short> samples(FRAMES_BUFFER_SIZE * sfhIn.channels());
 
     // Quantization + encoding loop
     size_t nFrames;
     while((nFrames = sfhIn.readf(samples.data(), FRAMES_BUFFER_SIZE))) {
-        for(size_t i = 0; i < nFrames * sfhIn.channels(); ++i) {
-            int s = samples[i] + 32768;         // shift to [0,65535]
-            s = (s / step) * step + step/2;     // quantize
-            s -= 32768;                         // shift back
-            if(s > 32767) s = 32767;            // clamp
-            if(s < -32768) s = -32768;
-            obs.write_n_bits(static_cast<short>(s), bits);
-        }
+        size_t nSamples = nFrames * sfhIn.channels();
+        quantizer.quantize(samples.data(), nSamples);
+        for(size_t i = 0; i < nSamples; ++i)
+            obs.write_n_bits(quantizer.index(samples[i]), bits);
     }
-
-    // write format channels and samplerate
+    obs.close();
 
     cout << "Quantization complete: " << bits << " bits of resolution used.\n";
     return 0;
@@ -0,0 +1,34 @@
+#!/bin/bash
+#
+# Compression ratio and speed of lossy_codec's coefficient coding modes.
+#
+# Usage (from this directory, after building):
+#	./codec_report.sh [ audio_dir (def ../../data/audio) ]
+#
+
+BIN=../bin/lossy_codec
+AUDIO_DIR=${1:-../../data/audio}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+now() { date +%s.%N; }
+
+printf "%-14s %-6s %10s %10s %7s %10s %10s\n" file mode wav_bytes bin_bytes ratio enc_s dec_s
+for wav in "$AUDIO_DIR"/*.wav; do
+	name=$(basename "$wav")
+	wavBytes=$(stat -c %s "$wav")
+	for mode in fixed rice; do
+		opt=""
+		[ $mode = rice ] && opt="-rice"
+
+		t0=$(now)
+		$BIN $opt e "$wav" "$TMP/out.bin" > /dev/null || exit 1
+		t1=$(now)
+		$BIN d "$TMP/out.bin" "$TMP/out.wav" > /dev/null || exit 1
+		t2=$(now)
+
+		binBytes=$(stat -c %s "$TMP/out.bin")
+		awk -v n="$name" -v m=$mode -v w="$wavBytes" -v b="$binBytes" -v t0="$t0" -v t1="$t1" -v t2="$t2" \
+			'BEGIN { printf "%-14s %-6s %10d %10d %7.2f %10.3f %10.3f\n", n, m, w, b, w / b, t1 - t0, t2 - t1 }'
+	done
+done
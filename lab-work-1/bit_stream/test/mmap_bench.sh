@@ -0,0 +1,62 @@
+#!/bin/bash
+#
+# Time of bin2text, bin2wav and lossy_codec d with the std::fstream and the
+# memory-mapped (-mmap) ByteStream backends, on generated multi-GB inputs.
+# The inputs are read once before timing, so both backends use the page cache.
+#
+# Usage (from this directory, after building):
+#	./mmap_bench.sh [ size_MB (def 2048) ] [ work_dir (def /tmp) ]
+#
+
+BIN=../bin
+SIZE_MB=${1:-2048}
+TMP=$(mktemp -d "${2:-/tmp}/mmap_bench.XXXXXX")
+trap 'rm -rf "$TMP"' EXIT
+
+now() { date +%s.%N; }
+
+le16() { printf "$(printf '\\x%02x\\x%02x' $(($1 & 255)) $(($1 >> 8 & 255)))"; }
+le32() { le16 $(($1 & 65535)); le16 $(($1 >> 16 & 65535)); }
+
+# Stereo PCM16 WAV with SIZE_MB of noise (at most 4 GB, the WAV limit)
+wav_noise() {
+	local bytes=$(($1 * 1048576))
+	{
+		printf "RIFF"; le32 $((bytes + 36)); printf "WAVEfmt "
+		le32 16; le16 1; le16 2; le32 44100; le32 $((44100 * 4)); le16 4; le16 16
+		printf "data"; le32 $bytes
+		head -c $bytes /dev/urandom
+	} > "$2"
+}
+
+run() { # name, command...
+	local name=$1
+	shift
+	local t0=$(now)
+	"$@" > /dev/null 2>&1
+	local rc=$?
+	local t1=$(now)
+	if [ $rc -ne 0 ]; then
+		printf "%-28s %10s\n" "$name" failed
+	else
+		awk -v n="$name" -v t0="$t0" -v t1="$t1" -v mb="$MB" \
+			'BEGIN { printf "%-28s %10.3f %10.1f\n", n, t1 - t0, mb / (t1 - t0) }'
+	fi
+}
+
+echo "Generating inputs ($SIZE_MB MB) in $TMP ..."
+head -c $((SIZE_MB * 1048576)) /dev/urandom > "$TMP/bits.bin"
+wav_noise $((SIZE_MB < 4000 ? SIZE_MB : 4000)) "$TMP/noise.wav"
+$BIN/lossy_codec -mmap e "$TMP/noise.wav" "$TMP/noise.lc" > /dev/null || exit 1
+$BIN/wav2bin "$TMP/noise.wav" "$TMP/noise.w2b" 16 > /dev/null || exit 1
+cat "$TMP/bits.bin" "$TMP/noise.lc" "$TMP/noise.w2b" > /dev/null
+
+printf "%-28s %10s %10s\n" tool time_s in_MB/s
+for opt in "" -mmap; do
+	MB=$(($(stat -c %s "$TMP/bits.bin") / 1048576))
+	run "bin2text $opt" $BIN/bin2text $opt "$TMP/bits.bin" /dev/null
+	MB=$(($(stat -c %s "$TMP/noise.w2b") / 1048576))
+	run "bin2wav $opt" $BIN/bin2wav $opt "$TMP/noise.w2b" "$TMP/out.wav"
+	MB=$(($(stat -c %s "$TMP/noise.lc") / 1048576))
+	run "lossy_codec d $opt" $BIN/lossy_codec $opt d "$TMP/noise.lc" /dev/null
+done
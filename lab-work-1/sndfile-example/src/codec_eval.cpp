@@ -0,0 +1,251 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <algorithm>
+#include <utility>
+#include <sndfile.hh>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "wav_cmp.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+constexpr size_t FRAMES_BUFFER_SIZE = 65536;
+
+// One setting of a codec: the commands of its encoder and decoder ({in},
+// {enc} and {out} are replaced by the paths). A codec with no decoder writes
+// the decoded WAV directly; as its output is not compressed, its rate is the
+// nominal one, nominalBits per sample.
+struct Setting {
+    string codec;
+    string name;
+    vector<string> encode;
+    vector<string> decode;
+    double nominalBits = 0;
+};
+
+struct RunResult {
+    bool ok = false;
+    double seconds = 0;
+    long maxRssKB = 0;
+};
+
+// Runs a command (output discarded), measuring its wall time and, with wait4,
+// its peak resident memory
+static RunResult run(vector<string> args, const string& in, const string& enc, const string& out) {
+    for (auto& arg : args) {
+        if (arg == "{in}") arg = in;
+        else if (arg == "{enc}") arg = enc;
+        else if (arg == "{out}") arg = out;
+    }
+
+    RunResult result;
+    auto start = chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid < 0)
+        return result;
+
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(devNull, STDERR_FILENO);
+        vector<char*> argv;
+        for (auto& arg : args)
+            argv.push_back(arg.data());
+        argv.push_back(nullptr);
+        execv(argv[0], argv.data());
+        _exit(127);
+    }
+
+    int status;
+    rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return result;
+
+    result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    result.maxRssKB = usage.ru_maxrss;
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+// SNR (all channels) of a decoded file against the original, over their common
+// length; a mono output of a stereo original is compared with its downmix
+static double snrDb(const string& origFile, const string& decodedFile) {
+    SndfileHandle sfhOrig{origFile};
+    SndfileHandle sfhDec{decodedFile};
+    if (sfhDec.error() || sfhOrig.samplerate() != sfhDec.samplerate())
+        return NAN;
+
+    size_t nChannels = sfhDec.channels();
+    bool downmix = sfhOrig.channels() == 2 && nChannels == 1;
+    if (!downmix && static_cast<size_t>(sfhOrig.channels()) != nChannels)
+        return NAN;
+
+    WAVCmp cmp{nChannels};
+    vector<short> bufferOrig(FRAMES_BUFFER_SIZE * sfhOrig.channels());
+    vector<short> bufferDec(FRAMES_BUFFER_SIZE * nChannels);
+    size_t nFrames = min(sfhOrig.frames(), sfhDec.frames());
+    while (nFrames > 0) {
+        size_t nRead = sfhOrig.readf(bufferOrig.data(), min(nFrames, FRAMES_BUFFER_SIZE));
+        if (nRead == 0 || static_cast<size_t>(sfhDec.readf(bufferDec.data(), nRead)) != nRead)
+            break;
+
+        if (downmix)
+            for (size_t i = 0; i < nRead; ++i)
+                bufferOrig[i] = static_cast<short>((bufferOrig[2 * i] + bufferOrig[2 * i + 1]) / 2);
+
+        cmp.update(bufferOrig.data(), bufferDec.data(), nRead);
+        nFrames -= nRead;
+    }
+
+    double power = 0, mse = 0;
+    for (size_t ch = 0; ch < nChannels; ++ch) {
+        power += cmp.power(ch);
+        mse += cmp.mse(ch);
+    }
+    return mse == 0 ? INFINITY : 10 * log10(power / mse);
+}
+
+static vector<Setting> settings(const string& binDir, const string& codecBinDir) {
+    vector<Setting> all;
+
+    for (int bits = 1; bits <= 16; ++bits)
+        all.push_back({"wav_quant", to_string(bits) + " bits",
+                       {binDir + "/wav_quant", "{in}", "{out}", to_string(bits)}, {}, static_cast<double>(bits)});
+
+    for (double frac : {0.05, 0.1, 0.2, 0.3, 0.5, 1.0}) {
+        string value = to_string(frac).substr(0, 4);
+        all.push_back({"wav_dct", "-frac " + value,
+                       {binDir + "/wav_dct", "-frac", value, "{in}", "{out}"}, {}, 16 * frac});
+    }
+
+    for (string coding : {"", "-rice"})
+        for (string stereo : {"", "-ms"}) {
+            vector<string> encode{codecBinDir + "/lossy_codec"};
+            string name = coding.empty() ? "fixed" : "rice";
+            for (const string& opt : {coding, stereo})
+                if (!opt.empty())
+                    encode.push_back(opt);
+            if (!stereo.empty())
+                name += " " + stereo;
+            encode.insert(encode.end(), {"e", "{in}", "{enc}"});
+            all.push_back({"lossy_codec", name, encode, {codecBinDir + "/lossy_codec", "d", "{enc}", "{out}"}});
+        }
+
+    // Quality/size trade-offs of the Rice coding: scales of the quantization
+    // steps, bitrate targets (each block takes the finest scale that fits) and
+    // block sizes (low-latency and archive ends of the range)
+    for (auto [opt, value] : vector<pair<string, string>>{{"-q", "0.5"}, {"-q", "2"}, {"-q", "4"}, {"-qp", "flat"},
+                                                          {"-kbps", "32"}, {"-kbps", "64"}, {"-kbps", "128"},
+                                                          {"-bs", "256"}, {"-bs", "4096"}})
+        all.push_back({"lossy_codec", "rice " + opt + " " + value,
+                       {codecBinDir + "/lossy_codec", "-rice", opt, value, "e", "{in}", "{enc}"},
+                       {codecBinDir + "/lossy_codec", "d", "{enc}", "{out}"}});
+
+    return all;
+}
+
+// Runs every codec setting over every WAV file of a directory and writes a
+// rate-distortion table (one row per file and setting)
+int main(int argc, char* argv[]) {
+    string audioDir = "../../data/audio";
+    string binDir = "../bin";
+    string codecBinDir = "../../bit_stream/bin";
+    string only;
+
+    int n = 1;
+    for (; n + 1 < argc; n += 2) {
+        string opt = argv[n];
+        if (opt == "-audio")
+            audioDir = argv[n + 1];
+        else if (opt == "-bin")
+            binDir = argv[n + 1];
+        else if (opt == "-codec_bin")
+            codecBinDir = argv[n + 1];
+        else if (opt == "-c")
+            only = "," + string(argv[n + 1]) + ",";
+        else
+            break;
+    }
+
+    if (n != argc) {
+        cerr << "Usage: codec_eval [-audio dir (def ../../data/audio)] [-bin dir (def ../bin)]\n";
+        cerr << "                  [-codec_bin dir (def ../../bit_stream/bin)] [-c codec1,codec2,...]\n";
+        cerr << "  Codecs: wav_quant (bits 1-16), wav_dct (-frac), lossy_codec (coding, mid/side,\n";
+        cerr << "          quantization scale and profile, target kbps, block size)\n";
+        cerr << "  Rates of wav_quant and wav_dct are nominal (bits per sample, kept coefficients at 16 bits)\n";
+        return 1;
+    }
+
+    vector<string> files;
+    for (const auto& entry : fs::directory_iterator(audioDir))
+        if (entry.path().extension() == ".wav")
+            files.push_back(entry.path().string());
+    sort(files.begin(), files.end());
+
+    char tmpTemplate[] = "/tmp/codec_eval.XXXXXX";
+    if (!mkdtemp(tmpTemplate)) {
+        cerr << "Error: cannot create a temporary directory\n";
+        return 1;
+    }
+    string tmpDir = tmpTemplate;
+    string encFile = tmpDir + "/enc.bin";
+    string outFile = tmpDir + "/out.wav";
+
+    cout.setf(ios::fixed);
+    cout.precision(3);
+    cout << "file\tcodec\tsetting\tbytes\tkbps\tbits_per_sample\tsnr_db\tenc_MBps\tenc_xrt\tdec_MBps\tdec_xrt\tpeak_rss_KB\n";
+
+    int failures = 0;
+    for (const auto& file : files) {
+        SndfileHandle sfh{file};
+        if (sfh.error()) {
+            cerr << "Warning: skipping " << file << "\n";
+            continue;
+        }
+        double seconds = static_cast<double>(sfh.frames()) / sfh.samplerate();
+        double pcmMB = static_cast<double>(sfh.frames() * sfh.channels() * 2) / 1048576;
+        double nSamples = static_cast<double>(sfh.frames() * sfh.channels());
+
+        for (const auto& setting : settings(binDir, codecBinDir)) {
+            if (!only.empty() && only.find("," + setting.codec + ",") == string::npos)
+                continue;
+
+            fs::remove(encFile);
+            fs::remove(outFile);
+            RunResult enc = run(setting.encode, file, encFile, outFile);
+            RunResult dec;
+            if (enc.ok && !setting.decode.empty())
+                dec = run(setting.decode, file, encFile, outFile);
+
+            string name = fs::path(file).filename().string();
+            if (!enc.ok || (!setting.decode.empty() && !dec.ok)) {
+                cout << name << '\t' << setting.codec << '\t' << setting.name << "\tfailed\n";
+                failures++;
+                continue;
+            }
+
+            double bytes = setting.decode.empty() ? nSamples * setting.nominalBits / 8
+                                                  : static_cast<double>(fs::file_size(encFile));
+            cout << name << '\t' << setting.codec << '\t' << setting.name << '\t'
+                 << static_cast<size_t>(bytes) << '\t' << bytes * 8 / seconds / 1000 << '\t'
+                 << bytes * 8 / nSamples << '\t' << snrDb(file, outFile) << '\t'
+                 << pcmMB / enc.seconds << '\t' << seconds / enc.seconds << '\t';
+            if (setting.decode.empty())
+                cout << "-\t-\t";
+            else
+                cout << pcmMB / dec.seconds << '\t' << seconds / dec.seconds << '\t';
+            cout << max(enc.maxRssKB, dec.maxRssKB) << '\n';
+        }
+    }
+
+    fs::remove_all(tmpDir);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#ifndef DELAY_LINE_H
+#define DELAY_LINE_H
+
+#include <cstddef>
+#include <vector>
+
+// Ring buffer holding the most recent samples of an (interleaved) stream. Its
+// size is the maximum delay rounded up to a power of two, so memory does not
+// depend on the length of the stream.
+template <typename T>
+class DelayLine {
+private:
+    std::vector<T> buffer;
+    size_t mask;
+    size_t writePos = 0;
+
+public:
+    // maxDelay is in samples (frames * channels)
+    explicit DelayLine(size_t maxDelay) {
+        size_t size = 1;
+        while (size < maxDelay + 1)
+            size <<= 1;
+
+        buffer.assign(size, T{});
+        mask = size - 1;
+    }
+
+    void push(T sample) {
+        buffer[writePos] = sample;
+        writePos = (writePos + 1) & mask;
+    }
+
+    // Sample pushed "delay" samples before the last one (tap(0) is the last
+    // one); samples before the start of the stream are zero
+    T tap(size_t delay) const {
+        return buffer[(writePos - 1 - delay) & mask];
+    }
+};
+
+#endif
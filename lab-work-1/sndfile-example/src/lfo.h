@@ -0,0 +1,57 @@
+#ifndef LFO_H
+#define LFO_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Low-frequency sine oscillator. Instead of calling sin() for every frame, a
+// 64-bit phase accumulator (a whole period is 2^64, so it wraps around by
+// itself and never drifts) indexes a precomputed table of one period, which
+// is linearly interpolated (maximum error about 3e-7).
+class LFO {
+private:
+    static constexpr int TABLE_BITS = 12;
+
+    const float* table;
+    uint64_t phase;
+    uint64_t increment;
+
+    // One period of sin, plus a copy of the first value for the interpolation
+    static const std::vector<float>& sineTable() {
+        static const std::vector<float> values = [] {
+            std::vector<float> t((1 << TABLE_BITS) + 1);
+            for (size_t i = 0; i < t.size(); ++i)
+                t[i] = static_cast<float>(std::sin(2 * M_PI * i / (1 << TABLE_BITS)));
+            return t;
+        }();
+        return values;
+    }
+
+    // Fraction of a period as a 64-bit phase
+    static uint64_t toPhase(double periods) {
+        periods -= std::floor(periods);
+        return static_cast<uint64_t>(periods * 18446744073709551616.0);
+    }
+
+public:
+    LFO(float freq, int sampleRate, double phase = 0.0)
+        : table(sineTable().data()),
+          phase(toPhase(phase / (2 * M_PI))),
+          increment(toPhase(static_cast<double>(freq) / sampleRate)) {}
+
+    // Writes sin(2 pi freq t / sampleRate + phase) for the next n frames t
+    void fill(float* values, size_t n) {
+        for (size_t f = 0; f < n; ++f) {
+            size_t index = phase >> (64 - TABLE_BITS);
+            // The next 31 bits of the phase, as a fraction in [0, 1)
+            float frac = static_cast<float>(static_cast<int32_t>((phase >> (33 - TABLE_BITS)) & 0x7fffffff)) *
+                         (1.0f / 2147483648.0f);
+            values[f] = table[index] + frac * (table[index + 1] - table[index]);
+            phase += increment;
+        }
+    }
+};
+
+#endif
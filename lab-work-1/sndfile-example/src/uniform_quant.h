@@ -0,0 +1,265 @@
+#ifndef UNIFORM_QUANT_H
+#define UNIFORM_QUANT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define UNIFORM_QUANT_X86
+#endif
+
+// Uniform quantization of 16-bit samples to a power-of-two step (2^shift,
+// with shift = 16 - bits), in place. Masking the low bits of the sample is
+// its floor to the step, so every level is q = (sat(s + rounding) & mask) | offset:
+//  - mid-rise (the original wav_quant): rounding = 0 and offset = step / 2,
+//    the centre of the interval, which is exactly ((s + 32768) / step) * step
+//    + step / 2 - 32768 with no clamping ever needed;
+//  - mid-tread: rounding = step / 2 and offset = 0, the nearest multiple of
+//    the step (halves upwards), saturated to the largest one, 32768 - step.
+// In both modes the level keeps only `bits` significant bits, so it maps to
+// an index of `bits` bits (see UniformQuantizer::index()).
+enum class QuantMode { MidRise, MidTread };
+
+struct QuantParams {
+    int shift = 0;
+    short mask = -1;
+    short rounding = 0;
+    short offset = 0;
+};
+
+// Dither noise: 16 xorshift32 generators, sample i of the stream taking the
+// next value of generator i % 16 (phase is the next one to use), so that the
+// noise does not depend on the kernel nor on how the stream is split in calls
+struct DitherState {
+    uint32_t lanes[16];
+    unsigned phase = 0;
+
+    explicit DitherState(uint32_t seed = 1) {
+        // splitmix32-like scrambling of seed + lane (never a zero state)
+        for (uint32_t lane = 0; lane < 16; ++lane) {
+            uint32_t x = seed + (lane + 1) * 0x9E3779B9u;
+            x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+            x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+            x ^= x >> 16;
+            lanes[lane] = x != 0 ? x : 0x6D2B79F5u;
+        }
+    }
+};
+
+// Triangular (TPDF) noise in (-step, step): the sum of the two 16-bit halves
+// of a random value, centred and scaled down to the step
+inline int ditherNoise(DitherState& dither, int shift) {
+    uint32_t x = dither.lanes[dither.phase];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    dither.lanes[dither.phase] = x;
+    dither.phase = (dither.phase + 1) & 15;
+    return (static_cast<int>(x & 0xFFFF) + static_cast<int>(x >> 16) - 65535) >> (16 - shift);
+}
+
+inline short quantizeSample(int sample, const QuantParams& p) {
+    int rounded = std::min(sample + p.rounding, 32767);
+    return static_cast<short>((rounded & p.mask) | p.offset);
+}
+
+// dither is null when not dithering
+inline void quantKernelScalar(short* samples, size_t n, const QuantParams& p, DitherState* dither) {
+    if (!dither) {
+        for (size_t i = 0; i < n; ++i)
+            samples[i] = quantizeSample(samples[i], p);
+        return;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        int noisy = std::clamp(samples[i] + ditherNoise(*dither, p.shift), -32768, 32767);
+        samples[i] = quantizeSample(noisy, p);
+    }
+}
+
+#ifdef UNIFORM_QUANT_X86
+
+__attribute__((target("avx2")))
+inline __m256i xorshiftAvx2(__m256i x) {
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    return _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+}
+
+__attribute__((target("avx2")))
+inline __m256i noiseAvx2(__m256i x, __m128i noiseShift) {
+    __m256i sum = _mm256_add_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xFFFF)), _mm256_srli_epi32(x, 16));
+    return _mm256_sra_epi32(_mm256_sub_epi32(sum, _mm256_set1_epi32(65535)), noiseShift);
+}
+
+// 16 samples per iteration; with dither they are widened to 32 bits to add
+// the noise of the 16 generators and packed back with saturation
+__attribute__((target("avx2")))
+inline void quantKernelAvx2(short* samples, size_t n, const QuantParams& p, DitherState* dither) {
+    const __m256i mask = _mm256_set1_epi16(p.mask);
+    const __m256i rounding = _mm256_set1_epi16(p.rounding);
+    const __m256i offset = _mm256_set1_epi16(p.offset);
+
+    size_t i = 0;
+    if (!dither) {
+        for (; i + 16 <= n; i += 16) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+            v = _mm256_or_si256(_mm256_and_si256(_mm256_adds_epi16(v, rounding), mask), offset);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), v);
+        }
+        quantKernelScalar(samples + i, n - i, p, dither);
+        return;
+    }
+
+    // Up to the first generator, so that each vector lane is always the same one
+    for (; i < n && dither->phase != 0; ++i)
+        quantKernelScalar(samples + i, 1, p, dither);
+
+    const __m128i noiseShift = _mm_cvtsi32_si128(16 - p.shift);
+    __m256i state0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dither->lanes));
+    __m256i state1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dither->lanes + 8));
+    for (; i + 16 <= n; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+        state0 = xorshiftAvx2(state0);
+        state1 = xorshiftAvx2(state1);
+        __m256i lo = _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)), noiseAvx2(state0, noiseShift));
+        __m256i hi = _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)), noiseAvx2(state1, noiseShift));
+        // packs works within 128-bit halves: put the 64-bit quarters back in order
+        v = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        v = _mm256_or_si256(_mm256_and_si256(_mm256_adds_epi16(v, rounding), mask), offset);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(samples + i), v);
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dither->lanes), state0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dither->lanes + 8), state1);
+
+    quantKernelScalar(samples + i, n - i, p, dither);
+}
+
+__attribute__((target("sse2")))
+inline __m128i xorshiftSse2(__m128i x) {
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+__attribute__((target("sse2")))
+inline __m128i noiseSse2(__m128i x, __m128i noiseShift) {
+    __m128i sum = _mm_add_epi32(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)), _mm_srli_epi32(x, 16));
+    return _mm_sra_epi32(_mm_sub_epi32(sum, _mm_set1_epi32(65535)), noiseShift);
+}
+
+// Same as the AVX2 kernel, with two vectors of 8 samples per iteration (the
+// samples are widened by unpacking with themselves and shifting, as SSE2 has
+// no sign extension)
+__attribute__((target("sse2")))
+inline void quantKernelSse2(short* samples, size_t n, const QuantParams& p, DitherState* dither) {
+    const __m128i mask = _mm_set1_epi16(p.mask);
+    const __m128i rounding = _mm_set1_epi16(p.rounding);
+    const __m128i offset = _mm_set1_epi16(p.offset);
+
+    size_t i = 0;
+    if (!dither) {
+        for (; i + 8 <= n; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i));
+            v = _mm_or_si128(_mm_and_si128(_mm_adds_epi16(v, rounding), mask), offset);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i), v);
+        }
+        quantKernelScalar(samples + i, n - i, p, dither);
+        return;
+    }
+
+    for (; i < n && dither->phase != 0; ++i)
+        quantKernelScalar(samples + i, 1, p, dither);
+
+    const __m128i noiseShift = _mm_cvtsi32_si128(16 - p.shift);
+    __m128i state[4];
+    for (int s = 0; s < 4; ++s)
+        state[s] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dither->lanes + 4 * s));
+    for (; i + 16 <= n; i += 16) {
+        for (int half = 0; half < 2; ++half) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + i + 8 * half));
+            __m128i& state0 = state[2 * half];
+            __m128i& state1 = state[2 * half + 1];
+            state0 = xorshiftSse2(state0);
+            state1 = xorshiftSse2(state1);
+            __m128i lo = _mm_add_epi32(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16), noiseSse2(state0, noiseShift));
+            __m128i hi = _mm_add_epi32(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16), noiseSse2(state1, noiseShift));
+            v = _mm_packs_epi32(lo, hi);
+            v = _mm_or_si128(_mm_and_si128(_mm_adds_epi16(v, rounding), mask), offset);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(samples + i + 8 * half), v);
+        }
+    }
+    for (int s = 0; s < 4; ++s)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dither->lanes + 4 * s), state[s]);
+
+    quantKernelScalar(samples + i, n - i, p, dither);
+}
+
+#endif
+
+using QuantKernel = void (*)(short*, size_t, const QuantParams&, DitherState*);
+
+// Best kernel for the running CPU, chosen once
+inline QuantKernel uniformQuantKernel() {
+    static const QuantKernel kernel = [] {
+#ifdef UNIFORM_QUANT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return &quantKernelAvx2;
+        if (__builtin_cpu_supports("sse2"))
+            return &quantKernelSse2;
+#endif
+        return &quantKernelScalar;
+    }();
+    return kernel;
+}
+
+// Reduces the resolution of 16-bit samples to `bits` bits (1 to 16), as used
+// by wav_quant and wav2bin. With dither, triangular noise of up to one step is
+// added before quantizing (not at 16 bits, where the samples are unchanged);
+// the same seed gives the same noise.
+class UniformQuantizer {
+private:
+    QuantParams params;
+    QuantMode quantMode;
+    bool dithered;
+    DitherState ditherState;
+    QuantKernel kernel;
+
+public:
+    UniformQuantizer(int bits, QuantMode mode = QuantMode::MidRise, bool dither = false, uint32_t seed = 1,
+                     QuantKernel kernel = uniformQuantKernel())
+        : quantMode(mode), dithered(dither && bits < 16), ditherState(seed), kernel(kernel) {
+        if (bits < 1 || bits > 16)
+            throw std::invalid_argument("bits must be between 1 and 16");
+
+        int step = 1 << (16 - bits);
+        params.shift = 16 - bits;
+        params.mask = static_cast<short>(-step);
+        params.rounding = static_cast<short>(mode == QuantMode::MidTread ? step / 2 : 0);
+        params.offset = static_cast<short>(mode == QuantMode::MidRise ? step / 2 : 0);
+    }
+
+    int bits() const { return 16 - params.shift; }
+    QuantMode mode() const { return quantMode; }
+
+    // Replaces each sample by its quantized level
+    void quantize(short* samples, size_t n) {
+        kernel(samples, n, params, dithered ? &ditherState : nullptr);
+    }
+
+    // Index (0 to 2^bits - 1, in increasing order of level) of a quantized
+    // sample, and the level of an index
+    uint16_t index(short level) const {
+        return static_cast<uint16_t>((static_cast<uint16_t>(level) ^ 0x8000) >> params.shift);
+    }
+
+    short level(uint16_t index) const {
+        return static_cast<short>(((index << params.shift) | params.offset) ^ 0x8000);
+    }
+};
+
+#endif
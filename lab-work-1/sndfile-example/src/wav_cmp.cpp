@@ -3,20 +3,54 @@
 #include <sndfile.hh>
 #include <cmath>
 #include <string>
+#include <memory>
+#include "wav_cmp.h"
 
 using namespace std;
 
 constexpr size_t FRAMES_BUFFER_SIZE = 65536;
 
-// Compute MSE, max error, and SNR
+static void printWorst(const char* title, const vector<WorstBlocks::Block>& blocks, size_t blockFrames,
+                       int sampleRate, const char* unit) {
+    if (blocks.empty())
+        return;
+
+    cout << "  " << title << ":\n";
+    for (const auto& b : blocks)
+        cout << "    channel " << b.channel << " at " << static_cast<double>(b.block * blockFrames) / sampleRate
+             << " s: " << b.value << unit << '\n';
+}
+
+// Compute MSE, max error, and SNR; optionally, segmental SNR and log-spectral
+// distance, with the worst blocks of each
 int main(int argc, char* argv[]) {
-    if (argc < 3) {
-        cerr << "Usage: wav_cmp <original.wav> <processed.wav>\n";
+    double segmentMs = 0;
+    size_t lsdBlock = 0;
+    size_t nWorst = 5;
+
+    int n = 1;
+    for (; n + 2 < argc; n += 2) {
+        string opt = argv[n];
+        if (opt == "-seg")
+            segmentMs = stod(argv[n + 1]);
+        else if (opt == "-lsd")
+            lsdBlock = stoul(argv[n + 1]);
+        else if (opt == "-worst")
+            nWorst = stoul(argv[n + 1]);
+        else
+            break;
+    }
+
+    if (argc < 3 || n != argc - 2) {
+        cerr << "Usage: wav_cmp [-seg window_ms] [-lsd block_size] [-worst n (def 5)] <original.wav> <processed.wav>\n";
+        cerr << "  -seg: also segmental SNR over windows of window_ms\n";
+        cerr << "  -lsd: also log-spectral distance over blocks of block_size frames (e.g. 1024)\n";
+        cerr << "  -worst: number of worst windows / blocks reported\n";
         return 1;
     }
 
-    string originalFile = argv[1];
-    string processedFile = argv[2];
+    string originalFile = argv[argc - 2];
+    string processedFile = argv[argc - 1];
 
     SndfileHandle sfhOrig{originalFile};
     SndfileHandle sfhProc{processedFile};
@@ -34,92 +68,64 @@ int main(int argc, char* argv[]) {
     }
 
     size_t nChannels = sfhOrig.channels();
-    vector<double> mse(nChannels, 0.0);
     vector<short> bufferOrig(FRAMES_BUFFER_SIZE * nChannels);
     vector<short> bufferProc(FRAMES_BUFFER_SIZE * nChannels);
-    vector<int> maxError(nChannels, 0);
-
-    double mseAvg = 0.0;
-    int maxErrorAvg = 0;
-    size_t totalSamples = 0;
-
-    // Read both files frame by frame
+    WAVCmp cmp{nChannels};
+
+    int sampleRate = sfhOrig.samplerate();
+    size_t segmentFrames = max<size_t>(1, lround(segmentMs * sampleRate / 1000));
+    unique_ptr<SegmentalSNR> segSnr;
+    unique_ptr<SpectralDistance> lsd;
+    if (segmentMs > 0)
+        segSnr = make_unique<SegmentalSNR>(nChannels, segmentFrames, nWorst);
+    if (lsdBlock > 0)
+        lsd = make_unique<SpectralDistance>(nChannels, lsdBlock, nWorst);
+
+    // Read both files once; all the metrics are accumulated together, from the
+    // same buffers, keeping only their current window or block
     size_t nRead;
     while ((nRead = sfhOrig.readf(bufferOrig.data(), FRAMES_BUFFER_SIZE)) > 0) {
         sfhProc.readf(bufferProc.data(), nRead);
-
-        for (size_t i = 0; i < nRead; ++i) {
-            double avgOrig = 0.0, avgProc = 0.0;
-
-            for (size_t ch = 0; ch < nChannels; ++ch) {
-                short o = bufferOrig[i * nChannels + ch];
-                short p = bufferProc[i * nChannels + ch];
-                int diff = o - p;
-
-                mse[ch] += diff * diff;
-                if (abs(diff) > maxError[ch])
-                    maxError[ch] = abs(diff);
-
-                avgOrig += o;
-                avgProc += p;
-            }
-
-            // Average (mono) channel
-            avgOrig /= nChannels;
-            avgProc /= nChannels;
-            int diffAvg = avgOrig - avgProc;
-            mseAvg += diffAvg * diffAvg;
-            if (abs(diffAvg) > maxErrorAvg)
-                maxErrorAvg = abs(diffAvg);
-        }
-
-        totalSamples += nRead;
-    }
-
-    // Compute final averages
-    for (size_t ch = 0; ch < nChannels; ++ch)
-        mse[ch] /= totalSamples;
-    mseAvg /= totalSamples;
-
-    // Compute SNR
-    sfhOrig.seek(0, SEEK_SET);
-    vector<double> power(nChannels, 0.0);
-    vector<double> powerAvg(nChannels, 0.0);
-    totalSamples = 0;
-
-    while ((nRead = sfhOrig.readf(bufferOrig.data(), FRAMES_BUFFER_SIZE)) > 0) {
-        for (size_t i = 0; i < nRead; ++i) {
-            double avg = 0.0;
-            for (size_t ch = 0; ch < nChannels; ++ch) {
-                short o = bufferOrig[i * nChannels + ch];
-                power[ch] += o * o;
-                avg += o;
-            }
-            avg /= nChannels;
-            powerAvg[0] += avg * avg;
-        }
-        totalSamples += nRead;
+        cmp.update(bufferOrig.data(), bufferProc.data(), nRead);
+        if (segSnr)
+            segSnr->update(bufferOrig.data(), bufferProc.data(), nRead);
+        if (lsd)
+            lsd->update(bufferOrig.data(), bufferProc.data(), nRead);
     }
 
-    for (size_t ch = 0; ch < nChannels; ++ch)
-        power[ch] /= totalSamples;
-    powerAvg[0] /= totalSamples;
-
     cout.setf(ios::fixed);
     cout.precision(4);
 
     cout << "\n=== WAV Comparison Results ===\n";
     for (size_t ch = 0; ch < nChannels; ++ch) {
-        double snr = 10 * log10(power[ch] / mse[ch]);
+        double snr = 10 * log10(cmp.power(ch) / cmp.mse(ch));
         cout << "Channel " << ch << ":\n";
-        cout << "  Mean Squared Error (L2): " << mse[ch] << '\n';
-        cout << "  Max Abs Error (L∞): " << maxError[ch] << '\n';
+        cout << "  Mean Squared Error (L2): " << cmp.mse(ch) << '\n';
+        cout << "  Max Abs Error (L∞): " << cmp.maxAbsError(ch) << '\n';
         cout << "  SNR: " << snr << " dB\n";
     }
 
-    double snrAvg = 10 * log10(powerAvg[0] / mseAvg);
+    double snrAvg = 10 * log10(cmp.powerAvg() / cmp.mseAvg());
     cout << "\nAverage (Mono):\n";
-    cout << "  Mean Squared Error (L2): " << mseAvg << '\n';
-    cout << "  Max Abs Error (L∞): " << maxErrorAvg << '\n';
+    cout << "  Mean Squared Error (L2): " << cmp.mseAvg() << '\n';
+    cout << "  Max Abs Error (L∞): " << cmp.maxAbsErrorAvg() << '\n';
     cout << "  SNR: " << snrAvg << " dB\n";
+
+    if (segSnr) {
+        segSnr->finish();
+        cout << "\nSegmental SNR (" << segmentFrames << "-frame windows, " << segSnr->segments()
+             << " windows, clamped to [" << static_cast<int>(SegmentalSNR::MIN_DB) << ", "
+             << static_cast<int>(SegmentalSNR::MAX_DB) << "] dB):\n";
+        for (size_t ch = 0; ch < nChannels; ++ch)
+            cout << "  Channel " << ch << ": " << segSnr->mean(ch) << " dB\n";
+        printWorst("Worst windows", segSnr->worstSegments(), segmentFrames, sampleRate, " dB");
+    }
+
+    if (lsd) {
+        lsd->finish();
+        cout << "\nLog-Spectral Distance (" << lsdBlock << "-frame blocks, " << lsd->blocks() << " blocks):\n";
+        for (size_t ch = 0; ch < nChannels; ++ch)
+            cout << "  Channel " << ch << ": " << lsd->mean(ch) << " dB\n";
+        printWorst("Worst blocks", lsd->worstBlocks(), lsdBlock, sampleRate, " dB");
+    }
 }
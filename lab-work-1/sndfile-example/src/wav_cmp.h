@@ -0,0 +1,527 @@
+#ifndef WAV_CMP_H
+#define WAV_CMP_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <fftw3.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define WAV_CMP_X86
+#endif
+
+// Sums of the comparison of interleaved 16-bit samples. In the kernels the
+// statistics of even and odd samples are kept apart (index 0 and 1): for a
+// stereo stream these are the two channels, for a mono one they are added at
+// the end. The sums are integers, so the result does not depend on the kernel
+// or on the order of the additions.
+struct CmpSums {
+    uint64_t errorEnergy[2] = {0, 0};
+    uint64_t signalEnergy[2] = {0, 0};
+    uint32_t maxError[2] = {0, 0};
+
+    // Average (mono) channel of a stereo stream, from the frame sums S: the
+    // error is trunc((So - Sp) / 2) and the signal energy is kept as S^2
+    uint64_t avgErrorEnergy = 0;
+    uint64_t avgSignalEnergy = 0;
+    uint32_t avgMaxError = 0;
+};
+
+// nSamples must be even for stereo streams (whole frames)
+inline void cmpKernelScalar(const short* orig, const short* proc, size_t nSamples, bool stereo, CmpSums& sums) {
+    for (size_t i = 0; i < nSamples; ++i) {
+        int64_t diff = orig[i] - proc[i];
+        sums.errorEnergy[i & 1] += diff * diff;
+        sums.signalEnergy[i & 1] += orig[i] * orig[i];
+        sums.maxError[i & 1] = std::max(sums.maxError[i & 1], static_cast<uint32_t>(std::abs(diff)));
+    }
+
+    if (!stereo)
+        return;
+
+    for (size_t i = 0; i < nSamples; i += 2) {
+        int64_t sumOrig = orig[i] + orig[i + 1];
+        int64_t diff = std::abs(sumOrig - proc[i] - proc[i + 1]) >> 1;
+        sums.avgErrorEnergy += diff * diff;
+        sums.avgSignalEnergy += sumOrig * sumOrig;
+        sums.avgMaxError = std::max(sums.avgMaxError, static_cast<uint32_t>(diff));
+    }
+}
+
+#ifdef WAV_CMP_X86
+
+// 16 samples per iteration: the samples are widened to 32 bits (the error
+// needs 17), the squares accumulated in 64-bit lanes, even lanes (channel 0)
+// and odd lanes (channel 1) with separate multiplications
+__attribute__((target("avx2")))
+inline void cmpKernelAvx2(const short* orig, const short* proc, size_t nSamples, bool stereo, CmpSums& sums) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i errorEven = _mm256_setzero_si256(), errorOdd = _mm256_setzero_si256();
+    __m256i signalEven = _mm256_setzero_si256(), signalOdd = _mm256_setzero_si256();
+    __m256i maxError = _mm256_setzero_si256();
+    __m256i avgError = _mm256_setzero_si256(), avgSignal = _mm256_setzero_si256();
+    __m256i avgMaxError = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 16 <= nSamples; i += 16) {
+        __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(orig + i));
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(proc + i));
+
+        for (int half = 0; half < 2; ++half) {
+            __m256i o32 = _mm256_cvtepi16_epi32(half ? _mm256_extracti128_si256(o, 1) : _mm256_castsi256_si128(o));
+            __m256i p32 = _mm256_cvtepi16_epi32(half ? _mm256_extracti128_si256(p, 1) : _mm256_castsi256_si128(p));
+            __m256i d = _mm256_sub_epi32(o32, p32);
+            __m256i dOdd = _mm256_srli_epi64(d, 32);
+            __m256i oOdd = _mm256_srli_epi64(o32, 32);
+
+            errorEven = _mm256_add_epi64(errorEven, _mm256_mul_epi32(d, d));
+            errorOdd = _mm256_add_epi64(errorOdd, _mm256_mul_epi32(dOdd, dOdd));
+            signalEven = _mm256_add_epi64(signalEven, _mm256_mul_epi32(o32, o32));
+            signalOdd = _mm256_add_epi64(signalOdd, _mm256_mul_epi32(oOdd, oOdd));
+            maxError = _mm256_max_epu32(maxError, _mm256_abs_epi32(d));
+        }
+
+        if (stereo) {
+            // Adjacent pairs of samples (the frames) added to 32 bits
+            __m256i sumOrig = _mm256_madd_epi16(o, ones);
+            __m256i sumProc = _mm256_madd_epi16(p, ones);
+            __m256i d = _mm256_srli_epi32(_mm256_abs_epi32(_mm256_sub_epi32(sumOrig, sumProc)), 1);
+            __m256i dOdd = _mm256_srli_epi64(d, 32);
+            __m256i sOdd = _mm256_srli_epi64(sumOrig, 32);
+
+            avgError = _mm256_add_epi64(avgError, _mm256_add_epi64(_mm256_mul_epu32(d, d), _mm256_mul_epu32(dOdd, dOdd)));
+            avgSignal = _mm256_add_epi64(avgSignal,
+                _mm256_add_epi64(_mm256_mul_epi32(sumOrig, sumOrig), _mm256_mul_epi32(sOdd, sOdd)));
+            avgMaxError = _mm256_max_epu32(avgMaxError, d);
+        }
+    }
+
+    alignas(32) uint64_t lanes64[4];
+    alignas(32) uint32_t lanes32[8];
+    const __m256i totals[] = {errorEven, errorOdd, signalEven, signalOdd, avgError, avgSignal};
+    uint64_t* targets[] = {&sums.errorEnergy[0], &sums.errorEnergy[1], &sums.signalEnergy[0],
+                           &sums.signalEnergy[1], &sums.avgErrorEnergy, &sums.avgSignalEnergy};
+    for (int n = 0; n < 6; ++n) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes64), totals[n]);
+        for (int lane = 0; lane < 4; ++lane)
+            *targets[n] += lanes64[lane];
+    }
+
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes32), maxError);
+    for (int lane = 0; lane < 8; ++lane)
+        sums.maxError[lane & 1] = std::max(sums.maxError[lane & 1], lanes32[lane]);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes32), avgMaxError);
+    for (int lane = 0; lane < 8; ++lane)
+        sums.avgMaxError = std::max(sums.avgMaxError, lanes32[lane]);
+
+    cmpKernelScalar(orig + i, proc + i, nSamples - i, stereo, sums);
+}
+
+// Same as the AVX2 kernel, 8 samples per iteration
+__attribute__((target("sse4.1")))
+inline void cmpKernelSse41(const short* orig, const short* proc, size_t nSamples, bool stereo, CmpSums& sums) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i errorEven = _mm_setzero_si128(), errorOdd = _mm_setzero_si128();
+    __m128i signalEven = _mm_setzero_si128(), signalOdd = _mm_setzero_si128();
+    __m128i maxError = _mm_setzero_si128();
+    __m128i avgError = _mm_setzero_si128(), avgSignal = _mm_setzero_si128();
+    __m128i avgMaxError = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 8 <= nSamples; i += 8) {
+        __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(orig + i));
+        __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(proc + i));
+
+        for (int half = 0; half < 2; ++half) {
+            __m128i o32 = _mm_cvtepi16_epi32(half ? _mm_srli_si128(o, 8) : o);
+            __m128i p32 = _mm_cvtepi16_epi32(half ? _mm_srli_si128(p, 8) : p);
+            __m128i d = _mm_sub_epi32(o32, p32);
+            __m128i dOdd = _mm_srli_epi64(d, 32);
+            __m128i oOdd = _mm_srli_epi64(o32, 32);
+
+            errorEven = _mm_add_epi64(errorEven, _mm_mul_epi32(d, d));
+            errorOdd = _mm_add_epi64(errorOdd, _mm_mul_epi32(dOdd, dOdd));
+            signalEven = _mm_add_epi64(signalEven, _mm_mul_epi32(o32, o32));
+            signalOdd = _mm_add_epi64(signalOdd, _mm_mul_epi32(oOdd, oOdd));
+            maxError = _mm_max_epu32(maxError, _mm_abs_epi32(d));
+        }
+
+        if (stereo) {
+            __m128i sumOrig = _mm_madd_epi16(o, ones);
+            __m128i sumProc = _mm_madd_epi16(p, ones);
+            __m128i d = _mm_srli_epi32(_mm_abs_epi32(_mm_sub_epi32(sumOrig, sumProc)), 1);
+            __m128i dOdd = _mm_srli_epi64(d, 32);
+            __m128i sOdd = _mm_srli_epi64(sumOrig, 32);
+
+            avgError = _mm_add_epi64(avgError, _mm_add_epi64(_mm_mul_epu32(d, d), _mm_mul_epu32(dOdd, dOdd)));
+            avgSignal = _mm_add_epi64(avgSignal, _mm_add_epi64(_mm_mul_epi32(sumOrig, sumOrig), _mm_mul_epi32(sOdd, sOdd)));
+            avgMaxError = _mm_max_epu32(avgMaxError, d);
+        }
+    }
+
+    alignas(16) uint64_t lanes64[2];
+    alignas(16) uint32_t lanes32[4];
+    const __m128i totals[] = {errorEven, errorOdd, signalEven, signalOdd, avgError, avgSignal};
+    uint64_t* targets[] = {&sums.errorEnergy[0], &sums.errorEnergy[1], &sums.signalEnergy[0],
+                           &sums.signalEnergy[1], &sums.avgErrorEnergy, &sums.avgSignalEnergy};
+    for (int n = 0; n < 6; ++n) {
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes64), totals[n]);
+        for (int lane = 0; lane < 2; ++lane)
+            *targets[n] += lanes64[lane];
+    }
+
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes32), maxError);
+    for (int lane = 0; lane < 4; ++lane)
+        sums.maxError[lane & 1] = std::max(sums.maxError[lane & 1], lanes32[lane]);
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes32), avgMaxError);
+    for (int lane = 0; lane < 4; ++lane)
+        sums.avgMaxError = std::max(sums.avgMaxError, lanes32[lane]);
+
+    cmpKernelScalar(orig + i, proc + i, nSamples - i, stereo, sums);
+}
+
+#endif
+
+using CmpKernel = void (*)(const short*, const short*, size_t, bool, CmpSums&);
+
+// Best kernel for the running CPU, chosen once
+inline CmpKernel cmpKernel() {
+    static const CmpKernel kernel = [] {
+#ifdef WAV_CMP_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return &cmpKernelAvx2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return &cmpKernelSse41;
+#endif
+        return &cmpKernelScalar;
+    }();
+    return kernel;
+}
+
+// Error and signal statistics of a processed stream against the original, per
+// channel and for their average (mono), accumulated in one pass over both
+class WAVCmp {
+private:
+    size_t nChannels;
+    size_t nFrames = 0;
+    CmpSums sums;
+
+    // More than 2 channels: the original per-frame loop
+    std::vector<uint64_t> errorEnergy, signalEnergy;
+    std::vector<int> maxError;
+    uint64_t avgErrorEnergy = 0;
+    double avgSignalEnergy = 0;
+    int avgMaxError = 0;
+
+    void updateGeneric(const short* orig, const short* proc, size_t frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            double avgOrig = 0.0, avgProc = 0.0;
+            for (size_t ch = 0; ch < nChannels; ++ch) {
+                int o = orig[i * nChannels + ch];
+                int p = proc[i * nChannels + ch];
+                int64_t diff = o - p;
+
+                errorEnergy[ch] += diff * diff;
+                signalEnergy[ch] += o * o;
+                maxError[ch] = std::max(maxError[ch], static_cast<int>(std::abs(diff)));
+                avgOrig += o;
+                avgProc += p;
+            }
+
+            avgOrig /= nChannels;
+            avgProc /= nChannels;
+            int64_t diffAvg = static_cast<int>(avgOrig - avgProc);
+            avgErrorEnergy += diffAvg * diffAvg;
+            avgSignalEnergy += avgOrig * avgOrig;
+            avgMaxError = std::max(avgMaxError, static_cast<int>(std::abs(diffAvg)));
+        }
+    }
+
+public:
+    explicit WAVCmp(size_t nChannels)
+        : nChannels(nChannels),
+          errorEnergy(nChannels, 0), signalEnergy(nChannels, 0), maxError(nChannels, 0) {}
+
+    void update(const short* orig, const short* proc, size_t frames) {
+        nFrames += frames;
+        if (nChannels <= 2)
+            cmpKernel()(orig, proc, frames * nChannels, nChannels == 2, sums);
+        else
+            updateGeneric(orig, proc, frames);
+    }
+
+    size_t frames() const { return nFrames; }
+
+    // Mean squared error and mean signal power of a channel
+    double mse(size_t ch) const {
+        if (nChannels > 2)
+            return static_cast<double>(errorEnergy[ch]) / nFrames;
+        return static_cast<double>(nChannels == 2 ? sums.errorEnergy[ch] : sums.errorEnergy[0] + sums.errorEnergy[1]) / nFrames;
+    }
+
+    double power(size_t ch) const {
+        if (nChannels > 2)
+            return static_cast<double>(signalEnergy[ch]) / nFrames;
+        return static_cast<double>(nChannels == 2 ? sums.signalEnergy[ch] : sums.signalEnergy[0] + sums.signalEnergy[1]) / nFrames;
+    }
+
+    int maxAbsError(size_t ch) const {
+        if (nChannels > 2)
+            return maxError[ch];
+        return nChannels == 2 ? sums.maxError[ch] : std::max(sums.maxError[0], sums.maxError[1]);
+    }
+
+    // The same for the average of the channels (truncated to an integer for
+    // the error); for a mono stream it is the channel itself
+    double mseAvg() const {
+        if (nChannels > 2)
+            return static_cast<double>(avgErrorEnergy) / nFrames;
+        return nChannels == 2 ? static_cast<double>(sums.avgErrorEnergy) / nFrames : mse(0);
+    }
+
+    double powerAvg() const {
+        if (nChannels > 2)
+            return avgSignalEnergy / nFrames;
+        return nChannels == 2 ? sums.avgSignalEnergy / 4.0 / nFrames : power(0);
+    }
+
+    int maxAbsErrorAvg() const {
+        if (nChannels > 2)
+            return avgMaxError;
+        return nChannels == 2 ? sums.avgMaxError : maxAbsError(0);
+    }
+};
+
+// The n worst blocks seen so far (lowest or highest values), in bounded memory
+class WorstBlocks {
+public:
+    struct Block {
+        double value;
+        size_t block;
+        size_t channel;
+    };
+
+private:
+    size_t n;
+    bool lowest;
+    // The best of the kept blocks on top, to be replaced by a worse one
+    std::function<bool(const Block&, const Block&)> better;
+    std::priority_queue<Block, std::vector<Block>, std::function<bool(const Block&, const Block&)>> kept;
+
+public:
+    WorstBlocks(size_t n, bool lowest)
+        : n(n), lowest(lowest),
+          better([lowest](const Block& a, const Block& b) { return lowest ? a.value < b.value : a.value > b.value; }),
+          kept(better) {}
+
+    void add(double value, size_t block, size_t channel) {
+        if (n == 0)
+            return;
+        if (kept.size() < n)
+            kept.push({value, block, channel});
+        else if (lowest ? value < kept.top().value : value > kept.top().value) {
+            kept.pop();
+            kept.push({value, block, channel});
+        }
+    }
+
+    // Worst first
+    std::vector<Block> sorted() const {
+        auto copy = kept;
+        std::vector<Block> blocks;
+        for (; !copy.empty(); copy.pop())
+            blocks.push_back(copy.top());
+        std::reverse(blocks.begin(), blocks.end());
+        return blocks;
+    }
+};
+
+// Segmental SNR: the SNR of each window of segmentFrames frames, per channel,
+// clamped to [MIN_DB, MAX_DB] (so that silent or perfect windows do not
+// dominate) and averaged over the windows
+class SegmentalSNR {
+public:
+    static constexpr double MIN_DB = -10.0;
+    static constexpr double MAX_DB = 35.0;
+
+private:
+    size_t nChannels;
+    size_t segmentFrames;
+    size_t filled = 0; // frames of the current segment
+    size_t nSegments = 0;
+    std::vector<uint64_t> errorEnergy, signalEnergy; // current segment
+    std::vector<double> snrSum;
+    WorstBlocks worst;
+
+    void accumulate(const short* orig, const short* proc, size_t frames) {
+        if (nChannels <= 2) {
+            CmpSums sums;
+            cmpKernel()(orig, proc, frames * nChannels, nChannels == 2, sums);
+            for (size_t ch = 0; ch < nChannels; ++ch) {
+                errorEnergy[ch] += nChannels == 2 ? sums.errorEnergy[ch] : sums.errorEnergy[0] + sums.errorEnergy[1];
+                signalEnergy[ch] += nChannels == 2 ? sums.signalEnergy[ch] : sums.signalEnergy[0] + sums.signalEnergy[1];
+            }
+            return;
+        }
+
+        for (size_t i = 0; i < frames * nChannels; ++i) {
+            int64_t diff = orig[i] - proc[i];
+            errorEnergy[i % nChannels] += diff * diff;
+            signalEnergy[i % nChannels] += orig[i] * orig[i];
+        }
+    }
+
+    void closeSegment() {
+        for (size_t ch = 0; ch < nChannels; ++ch) {
+            double snr = errorEnergy[ch] == 0 ? MAX_DB
+                : signalEnergy[ch] == 0 ? MIN_DB
+                : 10 * std::log10(static_cast<double>(signalEnergy[ch]) / errorEnergy[ch]);
+            snr = std::max(MIN_DB, std::min(snr, MAX_DB));
+
+            snrSum[ch] += snr;
+            worst.add(snr, nSegments, ch);
+            errorEnergy[ch] = signalEnergy[ch] = 0;
+        }
+        nSegments++;
+        filled = 0;
+    }
+
+public:
+    SegmentalSNR(size_t nChannels, size_t segmentFrames, size_t nWorst)
+        : nChannels(nChannels), segmentFrames(segmentFrames),
+          errorEnergy(nChannels, 0), signalEnergy(nChannels, 0), snrSum(nChannels, 0),
+          worst(nWorst, true) {}
+
+    void update(const short* orig, const short* proc, size_t frames) {
+        while (frames > 0) {
+            size_t n = std::min(frames, segmentFrames - filled);
+            accumulate(orig, proc, n);
+            orig += n * nChannels;
+            proc += n * nChannels;
+            frames -= n;
+            filled += n;
+            if (filled == segmentFrames)
+                closeSegment();
+        }
+    }
+
+    // Closes a last, shorter, segment
+    void finish() {
+        if (filled > 0)
+            closeSegment();
+    }
+
+    size_t segments() const { return nSegments; }
+    double mean(size_t ch) const { return nSegments == 0 ? 0 : snrSum[ch] / nSegments; }
+    std::vector<WorstBlocks::Block> worstSegments() const { return worst.sorted(); }
+};
+
+// Log-spectral distance of each block of blockSize frames, per channel: the
+// RMS over the bins (0 to blockSize / 2) of the difference, in dB, between
+// the power spectra of the original and the processed block (Hann window,
+// real-input FFT)
+class SpectralDistance {
+public:
+    // Power floor of a bin, so that silent bins give finite differences
+    static constexpr double POWER_FLOOR = 1.0;
+
+private:
+    size_t nChannels;
+    size_t blockSize;
+    size_t nBins;
+    size_t filled = 0; // frames of the current block
+    size_t nBlocks = 0;
+    std::vector<double> window;
+    std::vector<std::vector<double>> blockOrig, blockProc; // current block, per channel
+    double* in;
+    fftw_complex* spectrumOrig;
+    fftw_complex* spectrumProc;
+    fftw_plan plan;
+    std::vector<double> lsdSum;
+    WorstBlocks worst;
+
+    void closeBlock() {
+        // 10 * log10(a / b) = DB_PER_LN * ln(a / b)
+        const double DB_PER_LN = 10.0 / std::log(10.0);
+
+        std::fill(in, in + blockSize, 0.0);
+        for (size_t ch = 0; ch < nChannels; ++ch) {
+            for (size_t k = 0; k < filled; ++k)
+                in[k] = blockOrig[ch][k] * window[k];
+            fftw_execute_dft_r2c(plan, in, spectrumOrig);
+            for (size_t k = 0; k < filled; ++k)
+                in[k] = blockProc[ch][k] * window[k];
+            fftw_execute_dft_r2c(plan, in, spectrumProc);
+
+            double sum = 0;
+            for (size_t k = 0; k < nBins; ++k) {
+                double powerOrig = spectrumOrig[k][0] * spectrumOrig[k][0] + spectrumOrig[k][1] * spectrumOrig[k][1];
+                double powerProc = spectrumProc[k][0] * spectrumProc[k][0] + spectrumProc[k][1] * spectrumProc[k][1];
+                double db = DB_PER_LN * std::log((powerOrig + POWER_FLOOR) / (powerProc + POWER_FLOOR));
+                sum += db * db;
+            }
+
+            double lsd = std::sqrt(sum / nBins);
+            lsdSum[ch] += lsd;
+            worst.add(lsd, nBlocks, ch);
+        }
+        nBlocks++;
+        filled = 0;
+    }
+
+public:
+    SpectralDistance(size_t nChannels, size_t blockSize, size_t nWorst)
+        : nChannels(nChannels), blockSize(blockSize), nBins(blockSize / 2 + 1),
+          window(blockSize),
+          blockOrig(nChannels, std::vector<double>(blockSize)),
+          blockProc(nChannels, std::vector<double>(blockSize)),
+          in(fftw_alloc_real(blockSize)),
+          spectrumOrig(fftw_alloc_complex(nBins)),
+          spectrumProc(fftw_alloc_complex(nBins)),
+          plan(fftw_plan_dft_r2c_1d(blockSize, in, spectrumOrig, FFTW_ESTIMATE)),
+          lsdSum(nChannels, 0),
+          worst(nWorst, false)
+    {
+        for (size_t k = 0; k < blockSize; ++k)
+            window[k] = 0.5 - 0.5 * std::cos(2 * M_PI * k / blockSize);
+    }
+
+    SpectralDistance(const SpectralDistance&) = delete;
+    SpectralDistance& operator=(const SpectralDistance&) = delete;
+
+    ~SpectralDistance() {
+        fftw_destroy_plan(plan);
+        fftw_free(spectrumProc);
+        fftw_free(spectrumOrig);
+        fftw_free(in);
+    }
+
+    void update(const short* orig, const short* proc, size_t frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            for (size_t ch = 0; ch < nChannels; ++ch) {
+                blockOrig[ch][filled] = orig[i * nChannels + ch];
+                blockProc[ch][filled] = proc[i * nChannels + ch];
+            }
+            if (++filled == blockSize)
+                closeBlock();
+        }
+    }
+
+    // Closes a last, shorter, block (zero padded)
+    void finish() {
+        if (filled > 0)
+            closeBlock();
+    }
+
+    size_t blocks() const { return nBlocks; }
+    double mean(size_t ch) const { return nBlocks == 0 ? 0 : lsdSum[ch] / nBlocks; }
+    std::vector<WorstBlocks::Block> worstBlocks() const { return worst.sorted(); }
+};
+
+#endif
@@ -16,22 +16,110 @@
 //
 #include <iostream>
 #include <vector>
+#include <memory>
+#include <algorithm>
 #include <cmath>
+#include <chrono>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unistd.h>
 #include <fftw3.h>
 #include <sndfile.hh>
 
 using namespace std;
 
+// Loads the FFTW wisdom (plans measured by previous runs) of a cache file, if
+// there is one
+static bool load_wisdom(const string& file) {
+	return !file.empty() && fftw_import_wisdom_from_filename(file.c_str());
+}
+
+// Saves the accumulated wisdom to the cache file, through a temporary file
+// and a rename, so that concurrent runs never see a partial file
+static void save_wisdom(const string& file) {
+	if(file.empty())
+		return;
+
+	string tmp = file + ".tmp" + to_string(getpid());
+	if(!fftw_export_wisdom_to_filename(tmp.c_str()) || rename(tmp.c_str(), file.c_str()) != 0) {
+		cerr << "Warning: cannot save the FFTW wisdom to " << file << '\n';
+		remove(tmp.c_str());
+	}
+}
+
+// Blocks given to each thread in each batch read from the file
+constexpr size_t BLOCKS_PER_THREAD = 16;
+
+// SIMD-aligned buffer and plans of one thread. The buffer holds a block in its
+// interleaved order: the channels are nChannels transforms of stride
+// nChannels, done in a single batched call, with no copies per channel.
+struct DCTWorker {
+	double* x;
+	fftw_plan plan_d;
+	fftw_plan plan_i;
+
+	DCTWorker(size_t bs, size_t nChannels, unsigned planFlags) {
+		x = fftw_alloc_real(bs * nChannels);
+		int n[] { static_cast<int>(bs) };
+		int howMany { static_cast<int>(nChannels) };
+		int stride { static_cast<int>(nChannels) };
+		fftw_r2r_kind kind_d[] { FFTW_REDFT10 };
+		fftw_r2r_kind kind_i[] { FFTW_REDFT01 };
+		// Measuring plans overwrites the buffer, so it is done before use
+		plan_d = fftw_plan_many_r2r(1, n, howMany, x, nullptr, stride, 1, x, nullptr, stride, 1, kind_d, planFlags);
+		plan_i = fftw_plan_many_r2r(1, n, howMany, x, nullptr, stride, 1, x, nullptr, stride, 1, kind_i, planFlags);
+	}
+
+	DCTWorker(const DCTWorker&) = delete;
+	DCTWorker& operator=(const DCTWorker&) = delete;
+
+	~DCTWorker() {
+		fftw_destroy_plan(plan_d);
+		fftw_destroy_plan(plan_i);
+		fftw_free(x);
+	}
+
+	// Transforms a (zero padded) block, keeps only "dctFrac" of the "low
+	// frequency" coefficients and inverts it, in place
+	void process(short* block, size_t bs, size_t nChannels, double dctFrac) {
+		// Direct DCT
+		for(size_t i = 0 ; i < bs * nChannels ; i++)
+			x[i] = block[i];
+
+		fftw_execute(plan_d);
+		for(size_t k = 0 ; k < bs ; k++)
+			for(size_t c = 0 ; c < nChannels ; c++)
+				x[k * nChannels + c] = k < bs * dctFrac ? x[k * nChannels + c] / (bs << 1) : 0;
+
+		// Inverse DCT
+		fftw_execute(plan_i);
+		for(size_t i = 0 ; i < bs * nChannels ; i++)
+			block[i] = static_cast<short>(round(x[i]));
+	}
+};
+
 int main(int argc, char *argv[]) {
 
 	bool verbose { false };
 	size_t bs { 1024 };
 	double dctFrac { 0.2 };
+	// Measured plans only pay off when their wisdom is cached (-wisdom); a
+	// one-off run plans by estimate, which is also deterministic
+	unsigned planFlags { FFTW_ESTIMATE };
+	bool planGiven { false };
+	string wisdomFile;
+	unsigned nThreads { 1 };
 
 	if(argc < 3) {
 		cerr << "Usage: wav_dct [ -v (verbose) ]\n";
 		cerr << "               [ -bs blockSize (def 1024) ]\n";
 		cerr << "               [ -frac dctFraction (def 0.2) ]\n";
+		cerr << "               [ -plan estimate|measure|patient (FFTW planning, def estimate, measure with -wisdom) ]\n";
+		cerr << "               [ -wisdom cacheFile (reuses and saves the measured plans) ]\n";
+		cerr << "               [ -j nThreads (0 = all cores, at most 4 per core, def 1) ]\n";
 		cerr << "               wavFileIn wavFileOut\n";
 		return 1;
 	}
@@ -54,6 +142,46 @@ int main(int argc, char *argv[]) {
 			break;
 		}
 
+	for(int n = 1 ; n < argc ; n++)
+		if(string(argv[n]) == "-plan") {
+			string plan = argv[n+1];
+			if(plan == "estimate")
+				planFlags = FFTW_ESTIMATE;
+			else if(plan == "measure")
+				planFlags = FFTW_MEASURE;
+			else if(plan == "patient")
+				planFlags = FFTW_PATIENT;
+			else {
+				cerr << "Error: unknown planning mode " << plan << '\n';
+				return 1;
+			}
+			planGiven = true;
+			break;
+		}
+
+	for(int n = 1 ; n < argc ; n++)
+		if(string(argv[n]) == "-wisdom") {
+			wisdomFile = argv[n+1];
+			break;
+		}
+
+	if(!planGiven && !wisdomFile.empty())
+		planFlags = FFTW_MEASURE;
+
+	for(int n = 1 ; n < argc ; n++)
+		if(string(argv[n]) == "-j") {
+			int j = atoi(argv[n+1]);
+			if(j < 0) {
+				cerr << "Error: invalid number of threads " << argv[n+1] << '\n';
+				return 1;
+			}
+			// 0 = all cores; at most 4 threads per core (each one has its own
+			// buffer and plans)
+			unsigned nCores = max(1U, thread::hardware_concurrency());
+			nThreads = j == 0 ? nCores : min(static_cast<unsigned>(j), 4 * nCores);
+			break;
+		}
+
 	SndfileHandle sfhIn { argv[argc-2] };
 	if(sfhIn.error()) {
 		cerr << "Error: invalid input file\n";
@@ -85,52 +213,121 @@ int main(int argc, char *argv[]) {
 	}
 
 	size_t nChannels { static_cast<size_t>(sfhIn.channels()) };
-	size_t nFrames { static_cast<size_t>(sfhIn.frames()) };
 
-	// Read all samples: c1 c2 ... cn c1 c2 ... cn ...
+	// Blocks of frames: c1 c2 ... cn c1 c2 ... cn ...
 	// Note: A frame is a group c1 c2 ... cn
-	vector<short> samples(nChannels * nFrames);
-	sfhIn.readf(samples.data(), nFrames);
+	// Each batch of blocks (one block with a single thread) is transformed,
+	// truncated and inverted in its own buffer, so memory does not depend on
+	// the length of the file. The threads take the blocks of a batch in turn,
+	// each one in its own buffer.
+	size_t batchBlocks { nThreads == 1 ? 1 : nThreads * BLOCKS_PER_THREAD };
 
-	size_t nBlocks { static_cast<size_t>(ceil(static_cast<double>(nFrames) / bs)) };
+	// The FFTW planner is not thread-safe, so all plans are made here, before
+	// any thread runs. The plans of the other threads are then found in the
+	// wisdom of the first, so every thread executes the same algorithm and the
+	// result is identical for any number of threads.
+	auto planStart = chrono::steady_clock::now();
+	bool wisdomLoaded = load_wisdom(wisdomFile);
+	vector<unique_ptr<DCTWorker>> workers;
+	for(unsigned t = 0 ; t < nThreads ; t++)
+		workers.push_back(make_unique<DCTWorker>(bs, nChannels, planFlags));
+	save_wisdom(wisdomFile);
+	if(verbose)
+		cout << "Planning took " << chrono::duration<double, milli>(chrono::steady_clock::now() - planStart).count()
+		  << " ms" << (wisdomLoaded ? " (with cached wisdom)" : "") << '\n';
 
-	// Do zero padding, if necessary
-	samples.resize(nBlocks * bs * nChannels);
+	// Reads a batch and does the zero padding, if necessary; returns its frames
+	auto read_batch = [&](vector<short>& batch, size_t& nBlocks) {
+		size_t nFrames = sfhIn.readf(batch.data(), batchBlocks * bs);
+		nBlocks = (nFrames + bs - 1) / bs;
+		fill(batch.begin() + nFrames * nChannels, batch.begin() + nBlocks * bs * nChannels, 0);
+		return nFrames;
+	};
 
-	// Vector for holding all DCT coefficients, channel by channel
-	vector<vector<double>> x_dct(nChannels, vector<double>(nBlocks * bs));
+	size_t nFrames, nBlocks;
+	if(nThreads == 1) {
+		vector<short> batch(bs * nChannels);
+		while((nFrames = read_batch(batch, nBlocks))) {
+			workers[0]->process(batch.data(), bs, nChannels, dctFrac);
+			sfhOut.writef(batch.data(), nFrames);
+		}
+		return 0;
+	}
 
-	// Vector for holding DCT computations
-	vector<double> x(bs);
+	// The threads are started once and wait for each batch. There are two
+	// batch buffers: while the threads transform one, the main thread writes
+	// the previous batch from the other and reads the next one into it.
+	mutex m;
+	condition_variable batchReady, batchDone;
+	short* current { nullptr };
+	size_t currentBlocks { 0 };
+	size_t generation { 0 };
+	unsigned finished { 0 };
+	bool stop { false };
+	atomic<size_t> next { 0 };
 
-	// Direct DCT
-	fftw_plan plan_d = fftw_plan_r2r_1d(bs, x.data(), x.data(), FFTW_REDFT10, FFTW_ESTIMATE);
-	for(size_t n = 0 ; n < nBlocks ; n++)
-		for(size_t c = 0 ; c < nChannels ; c++) {
-			for(size_t k = 0 ; k < bs ; k++)
-				x[k] = samples[(n * bs + k) * nChannels + c];
+	vector<thread> threads;
+	for(unsigned t = 0 ; t < nThreads ; t++)
+		threads.emplace_back([&, t] {
+			size_t seen { 0 };
+			for(;;) {
+				unique_lock<mutex> lock { m };
+				batchReady.wait(lock, [&] { return stop || generation != seen; });
+				if(stop)
+					return;
+				seen = generation;
+				short* data { current };
+				size_t n { currentBlocks };
+				lock.unlock();
 
-			fftw_execute(plan_d);
-			// Keep only "dctFrac" of the "low frequency" coefficients
-			for(size_t k = 0 ; k < bs * dctFrac ; k++)
-				x_dct[c][n * bs + k] = x[k] / (bs << 1);
+				for(size_t b; (b = next++) < n;)
+					workers[t]->process(data + b * bs * nChannels, bs, nChannels, dctFrac);
 
-		}
+				lock.lock();
+				if(++finished == nThreads)
+					batchDone.notify_one();
+			}
+		});
 
-	// Inverse DCT
-	fftw_plan plan_i = fftw_plan_r2r_1d(bs, x.data(), x.data(), FFTW_REDFT01, FFTW_ESTIMATE);
-	for(size_t n = 0 ; n < nBlocks ; n++)
-		for(size_t c = 0 ; c < nChannels ; c++) {
-			for(size_t k = 0 ; k < bs ; k++)
-				x[k] = x_dct[c][n * bs + k];
+	vector<short> batches[2] { vector<short>(batchBlocks * bs * nChannels),
+	  vector<short>(batchBlocks * bs * nChannels) };
+	int cur { 0 };
+	size_t doneFrames { 0 };
+	nFrames = read_batch(batches[cur], nBlocks);
+	while(nFrames) {
+		{
+			lock_guard<mutex> lock { m };
+			current = batches[cur].data();
+			currentBlocks = nBlocks;
+			next = 0;
+			finished = 0;
+			generation++;
+		}
+		batchReady.notify_all();
 
-			fftw_execute(plan_i);
-			for(size_t k = 0 ; k < bs ; k++)
-				samples[(n * bs + k) * nChannels + c] = static_cast<short>(round(x[k]));
+		if(doneFrames)
+			sfhOut.writef(batches[1 - cur].data(), doneFrames);
+		size_t nextFrames { read_batch(batches[1 - cur], nBlocks) };
 
+		{
+			unique_lock<mutex> lock { m };
+			batchDone.wait(lock, [&] { return finished == nThreads; });
 		}
+		doneFrames = nFrames;
+		nFrames = nextFrames;
+		cur = 1 - cur;
+	}
+	if(doneFrames)
+		sfhOut.writef(batches[1 - cur].data(), doneFrames);
+
+	{
+		lock_guard<mutex> lock { m };
+		stop = true;
+	}
+	batchReady.notify_all();
+	for(auto& th : threads)
+		th.join();
 
-	sfhOut.writef(samples.data(), sfhIn.frames());
 	return 0;
 }
 
@@ -1,8 +1,8 @@
 #include <iostream>
 #include <vector>
 #include <sndfile.hh>
-#include <cmath>
 #include <string>
+#include "wav_effects.h"
 
 using namespace std;
 
@@ -12,12 +12,17 @@ constexpr size_t FRAMES_BUFFER_SIZE = 65536;
 int main(int argc, char* argv[]) {
     if (argc < 5) {
         cerr << "Usage:\n";
-        cerr << "  wav_effects <input.wav> <output.wav> <effect> <param1> [param2]\n\n";
+        cerr << "  wav_effects <input.wav> <output.wav> <effect> <param1> [param2]\n";
+        cerr << "  wav_effects <input.wav> <output.wav> --chain <effect:param1[:param2],...>\n\n";
         cerr << "Effects:\n";
         cerr << "  echo <delay_ms> <decay>           - Single echo\n";
-        cerr << "  multiecho <delay_ms> <decay>      - Multiple echoes\n";
+        cerr << "  multiecho <delay_ms> <decay> [n]  - Multiple echoes (def 5, 0 = infinite feedback)\n";
         cerr << "  am <freq_Hz>                      - Amplitude modulation\n";
         cerr << "  delaymod <max_delay_ms> <freq_Hz> - Time-varying delay (flanger-like)\n";
+        cerr << "  chorus <delay_ms> <depth_ms> <freq_Hz> [mix] - Chorus (def mix 0.5)\n";
+        cerr << "  vibrato <depth_ms> <freq_Hz>      - Vibrato (pitch modulation)\n";
+        cerr << "  (delaymod, chorus and vibrato take a last, optional, interpolation: 1 linear, 3 cubic (def))\n\n";
+        cerr << "Example: --chain \"echo:250:0.5,am:4,delaymod:5:0.5\" applies the effects in this order\n";
         return 1;
     }
 
@@ -31,86 +36,48 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    SndfileHandle sfhOut{outFile, SFM_WRITE, sfhIn.format(), sfhIn.channels(), sfhIn.samplerate()};
-    if (sfhOut.error()) {
-        cerr << "Error: cannot create output file\n";
-        return 1;
-    }
-
     int sampleRate = sfhIn.samplerate();
     int nChannels = sfhIn.channels();
-    vector<short> samples(FRAMES_BUFFER_SIZE * nChannels);
-
-    // Load entire file into memory
-    vector<short> allSamples;
-    size_t nRead;
-    while ((nRead = sfhIn.readf(samples.data(), FRAMES_BUFFER_SIZE)) > 0)
-        allSamples.insert(allSamples.end(), samples.begin(), samples.begin() + nRead * nChannels);
-
-    size_t totalSamples = allSamples.size();
-    vector<short> output = allSamples;
-
-    // --- Echo ---
-    if (effect == "echo") {
-        if (argc < 6) { cerr << "Usage: wav_effects input.wav output.wav echo <delay_ms> <decay>\n"; return 1; }
-        float delay_ms = stof(argv[4]);
-        float decay = stof(argv[5]);
-        size_t delaySamples = (size_t)((delay_ms / 1000.0f) * sampleRate);
-
-        for (size_t i = delaySamples * nChannels; i < totalSamples; ++i)
-            output[i] += static_cast<short>(decay * allSamples[i - delaySamples * nChannels]);
-    }
-
-    // --- Multiple echoes ---
-    else if (effect == "multiecho") {
-        if (argc < 6) { cerr << "Usage: wav_effects input.wav output.wav multiecho <delay_ms> <decay>\n"; return 1; }
-        float delay_ms = stof(argv[4]);
-        float decay = stof(argv[5]);
-        size_t delaySamples = (size_t)((delay_ms / 1000.0f) * sampleRate);
 
-        for (size_t echo = 1; echo <= 5; ++echo) {
-            float gain = pow(decay, echo);
-            for (size_t i = echo * delaySamples * nChannels; i < totalSamples; ++i)
-                output[i] += static_cast<short>(gain * allSamples[i - echo * delaySamples * nChannels]);
-        }
-    }
-
-    // --- Amplitude modulation ---
-    else if (effect == "am") {
-        if (argc < 5) { cerr << "Usage: wav_effects input.wav output.wav am <freq_Hz>\n"; return 1; }
-        float freq = stof(argv[4]);
-        for (size_t i = 0; i < totalSamples / nChannels; ++i) {
-            float mod = 0.5f * (1.0f + sin(2 * M_PI * freq * i / sampleRate));
-            for (int ch = 0; ch < nChannels; ++ch)
-                output[i * nChannels + ch] = static_cast<short>(allSamples[i * nChannels + ch] * mod);
+    // The stages of the chain (a single one, unless --chain is used)
+    vector<unique_ptr<Effect>> chain;
+    try {
+        if (effect == "--chain")
+            chain = makeEffectChain(argv[4], sampleRate, nChannels);
+        else {
+            vector<float> params;
+            for (int n = 4; n < argc; ++n)
+                params.push_back(stof(argv[n]));
+            chain.push_back(makeEffect(effect, params, sampleRate, nChannels));
         }
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << "\n";
+        return 1;
     }
 
-    // --- Time-varying delay (flanger / vibrato style) ---
-    else if (effect == "delaymod") {
-        if (argc < 6) { cerr << "Usage: wav_effects input.wav output.wav delaymod <max_delay_ms> <freq_Hz>\n"; return 1; }
-        float maxDelayMs = stof(argv[4]);
-        float freq = stof(argv[5]);
-        size_t maxDelaySamples = (size_t)((maxDelayMs / 1000.0f) * sampleRate);
-
-        for (size_t i = 0; i < totalSamples / nChannels; ++i) {
-            float mod = (sin(2 * M_PI * freq * i / sampleRate) + 1.0f) / 2.0f; // [0,1]
-            size_t delay = (size_t)(mod * maxDelaySamples);
-            for (int ch = 0; ch < nChannels; ++ch) {
-                size_t idx = i * nChannels + ch;
-                if (i > delay)
-                    output[idx] += static_cast<short>(0.7f * allSamples[idx - delay * nChannels]);
-            }
-        }
+    SndfileHandle sfhOut{outFile, SFM_WRITE, sfhIn.format(), sfhIn.channels(), sfhIn.samplerate()};
+    if (sfhOut.error()) {
+        cerr << "Error: cannot create output file\n";
+        return 1;
     }
 
-    else {
-        cerr << "Error: unknown effect '" << effect << "'\n";
-        return 1;
+    // Every chunk goes through all the stages while in memory; the stages keep
+    // their delayed samples in ring buffers, so memory does not grow with the
+    // length of the file
+    vector<short> samples;
+    while (true) {
+        samples.resize(FRAMES_BUFFER_SIZE * nChannels);
+        size_t nRead = sfhIn.readf(samples.data(), FRAMES_BUFFER_SIZE);
+        if (nRead == 0)
+            break;
+
+        samples.resize(nRead * nChannels); // The blocks hold whole frames only
+        for (auto& stage : chain)
+            stage->process(samples);
+
+        sfhOut.writef(samples.data(), nRead);
     }
 
-    // Write result
-    sfhOut.writef(output.data(), totalSamples / nChannels);
-    cout << "Effect '" << effect << "' applied successfully.\n";
+    cout << "Effect '" << (effect == "--chain" ? argv[4] : effect) << "' applied successfully.\n";
     return 0;
 }
@@ -0,0 +1,378 @@
+#ifndef WAVEFFECTS_H
+#define WAVEFFECTS_H
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "delay_line.h"
+#include "lfo.h"
+
+// An effect stage. Blocks are consecutive pieces of the same interleaved
+// stream, so stages keep their state (delay lines, time) between calls.
+class Effect {
+public:
+    virtual ~Effect() = default;
+
+    // Applies the effect, in place, to a block of interleaved samples
+    virtual void process(std::vector<short>& block) = 0;
+};
+
+// Delay in frames, as computed by the original wav_effects
+inline size_t delayFrames(float delayMs, int sampleRate) {
+    return (size_t)((delayMs / 1000.0f) * sampleRate);
+}
+
+// --- Echo ---
+class Echo : public Effect {
+private:
+    int nChannels;
+    size_t delay;
+    float decay;
+    DelayLine<short> delayLine;
+
+public:
+    Echo(int sampleRate, int nChannels, float delayMs, float decay)
+        : nChannels(nChannels), delay(delayFrames(delayMs, sampleRate)), decay(decay),
+          delayLine(delay * nChannels) {}
+
+    void process(std::vector<short>& block) override {
+        for (short& sample : block) {
+            delayLine.push(sample);
+            // Samples before the start of the stream are zero, and add nothing
+            sample += static_cast<short>(decay * delayLine.tap(delay * nChannels));
+        }
+    }
+};
+
+// Rounds toward zero, like a cast, but saturates instead of wrapping around
+inline short saturateToShort(float sample) {
+    return static_cast<short>(std::max(-32768.0f, std::min(sample, 32767.0f)));
+}
+
+// --- Multiple echoes ---
+// Feedback comb filter, y[n] = x[n] + g y[n - D], which adds the echoes
+// g^k x[n - kD] for every k >= 1 in one pass. For a finite number N of echoes
+// the term -g^(N+1) x[n - (N+1)D] cancels those after the N-th one. Each
+// channel is filtered in planar float ring buffers, in runs that neither wrap
+// around nor depend on their own output (at most D frames), so the inner loop
+// vectorizes; the result is saturated only once.
+class MultiEcho : public Effect {
+private:
+    int nChannels;
+    size_t delay;
+    size_t tailDelay = 0;   // (N + 1) D, or 0 for infinite feedback
+    float decay;
+    float tailGain = 0.0f;  // g^(N + 1), or 0 for infinite feedback
+    size_t inSize, outSize;
+    size_t pos = 0;
+    std::vector<std::vector<float>> input, output; // per channel rings
+
+    // Twice the longest delay read from a ring: a run (at most D frames)
+    // never overwrites samples that it still has to read
+    static size_t ringSize(size_t longestDelay) {
+        size_t size = 1;
+        while (size < 2 * longestDelay)
+            size <<= 1;
+        return size;
+    }
+
+public:
+    // Longest tail delay (N + 1) D: 2^23 frames, about 190 s at 44.1 kHz (the
+    // input ring then takes 64 MB per channel)
+    static constexpr size_t MAX_TAIL_FRAMES = size_t(1) << 23;
+
+    // nEchoes == 0 gives infinite feedback
+    MultiEcho(int sampleRate, int nChannels, float delayMs, float decay, size_t nEchoes = 5)
+        : nChannels(nChannels), delay(delayFrames(delayMs, sampleRate)), decay(decay) {
+        if (delay == 0)
+            throw std::invalid_argument("multiecho needs a delay of at least one frame");
+        if (std::abs(decay) > 1.0f || (nEchoes == 0 && std::abs(decay) == 1.0f))
+            throw std::invalid_argument("multiecho decay must be in [-1, 1] (in (-1, 1) for infinite echoes)");
+
+        // A cancelling term below float resolution changes nothing: infinite
+        // feedback then gives the same output, with no tail to keep
+        double cancelled = nEchoes == 0 ? 0.0 : std::pow(std::abs(decay), static_cast<double>(nEchoes) + 1.0);
+        if (cancelled >= std::numeric_limits<float>::epsilon()) {
+            if (nEchoes >= MAX_TAIL_FRAMES / delay)
+                throw std::invalid_argument("multiecho (n_echoes + 1) * delay must be at most 2^23 frames");
+            tailDelay = (nEchoes + 1) * delay;
+            tailGain = static_cast<float>(std::pow(decay, nEchoes + 1));
+        }
+
+        // The output ring is only read D frames back; the input ring also
+        // holds the tail
+        inSize = ringSize(std::max(delay, tailDelay));
+        outSize = ringSize(delay);
+        input.assign(nChannels, std::vector<float>(inSize, 0.0f));
+        output.assign(nChannels, std::vector<float>(outSize, 0.0f));
+    }
+
+    void process(std::vector<short>& block) override {
+        size_t nFrames = block.size() / nChannels;
+        size_t inMask = inSize - 1;
+        size_t outMask = outSize - 1;
+
+        for (int ch = 0; ch < nChannels; ++ch) {
+            float* in = input[ch].data();
+            float* out = output[ch].data();
+
+            for (size_t f = 0; f < nFrames; ) {
+                size_t wi = (pos + f) & inMask;
+                size_t t = (wi - tailDelay) & inMask;
+                size_t wo = (pos + f) & outMask;
+                size_t r = (wo - delay) & outMask;
+                size_t len = std::min({ nFrames - f, delay, inSize - wi, inSize - t, outSize - wo, outSize - r });
+
+                short* samples = block.data() + f * nChannels + ch;
+                for (size_t k = 0; k < len; ++k)
+                    in[wi + k] = samples[k * nChannels];
+                for (size_t k = 0; k < len; ++k)
+                    out[wo + k] = in[wi + k] + decay * out[r + k] - tailGain * in[t + k];
+                for (size_t k = 0; k < len; ++k)
+                    samples[k * nChannels] = saturateToShort(out[wo + k]);
+
+                f += len;
+            }
+        }
+
+        pos += nFrames;
+    }
+};
+
+// --- Amplitude modulation ---
+class AmplitudeModulation : public Effect {
+private:
+    int nChannels;
+    LFO lfo;
+    std::vector<float> mods;
+
+public:
+    AmplitudeModulation(int sampleRate, int nChannels, float freq)
+        : nChannels(nChannels), lfo(freq, sampleRate) {}
+
+    void process(std::vector<short>& block) override {
+        size_t nFrames = block.size() / nChannels;
+        mods.resize(nFrames);
+        lfo.fill(mods.data(), nFrames);
+
+        for (size_t f = 0; f < nFrames; ++f) {
+            float mod = 0.5f * (1.0f + mods[f]);
+            for (int ch = 0; ch < nChannels; ++ch)
+                block[f * nChannels + ch] = static_cast<short>(block[f * nChannels + ch] * mod);
+        }
+    }
+};
+
+enum class Interpolation { Linear, Cubic };
+
+// Modulated delay, the engine of delaymod (flanger), chorus and vibrato:
+// y[n] = dry x[n] + wet x[n - d(n)], with the fractional delay (in frames)
+// d(n) = base + depth (1 + lfo(n)) / 2, read by linear or cubic (Catmull-Rom)
+// interpolation. With a nonzero channelPhase each channel has its own LFO,
+// with phases spread by it. The delays of a segment (integer and fractional
+// parts) are computed first, and the segment is copied to a planar float
+// ring, so the interpolation loop has no dependencies between frames.
+class ModulatedDelay : public Effect {
+private:
+    static constexpr size_t SEGMENT_SIZE = 4096; // frames
+
+    int nChannels;
+    float base, depth;
+    float dry, wet;
+    Interpolation interpolation;
+    std::vector<LFO> lfos;
+    size_t size;
+    size_t pos = 0;
+    std::vector<std::vector<float>> rings; // per channel
+    std::vector<int> offsets;              // delays of the segment: integer
+    std::vector<float> fractions;          // and fractional parts
+
+    template <Interpolation I>
+    void processSegment(short* samples, size_t nFrames, float* ring) const {
+        size_t mask = size - 1;
+        for (size_t f = 0; f < nFrames; ++f) {
+            size_t k = offsets[f];
+            float x = fractions[f];
+            size_t n = pos + f;
+            float p1 = ring[(n - k) & mask], p2 = ring[(n - k - 1) & mask];
+
+            float delayed;
+            if constexpr (I == Interpolation::Linear)
+                delayed = p1 + x * (p2 - p1);
+            else {
+                // The newer neighbour of a delay below one frame is the current sample
+                float p0 = ring[(n - k + (k != 0)) & mask], p3 = ring[(n - k - 2) & mask];
+                delayed = p1 + 0.5f * x * (p2 - p0 + x * (2 * p0 - 5 * p1 + 4 * p2 - p3 +
+                                                        x * (3 * (p1 - p2) + p3 - p0)));
+            }
+
+            samples[f * nChannels] = saturateToShort(dry * ring[n & mask] + wet * delayed);
+        }
+    }
+
+public:
+    ModulatedDelay(int sampleRate, int nChannels, float baseMs, float depthMs, float freq, float dry, float wet,
+                   Interpolation interpolation, double channelPhase = 0.0)
+        : nChannels(nChannels), base(baseMs / 1000.0f * sampleRate), depth(depthMs / 1000.0f * sampleRate),
+          dry(dry), wet(wet), interpolation(interpolation), offsets(SEGMENT_SIZE), fractions(SEGMENT_SIZE) {
+        if (base < 0.0f || depth < 0.0f)
+            throw std::invalid_argument("delays must not be negative");
+
+        // Without a phase difference the channels share the same delays
+        for (int ch = 0; ch < (channelPhase == 0.0 ? 1 : nChannels); ++ch)
+            lfos.emplace_back(freq, sampleRate, ch * channelPhase);
+
+        // A whole segment is written before it is read, behind the longest delay
+        size = 1;
+        while (size < SEGMENT_SIZE + static_cast<size_t>(base + depth) + 3)
+            size <<= 1;
+        rings.assign(nChannels, std::vector<float>(size, 0.0f));
+    }
+
+    void process(std::vector<short>& block) override {
+        size_t nFrames = block.size() / nChannels;
+        size_t mask = size - 1;
+
+        for (size_t start = 0; start < nFrames; start += SEGMENT_SIZE) {
+            size_t len = std::min(SEGMENT_SIZE, nFrames - start);
+
+            for (int ch = 0; ch < nChannels; ++ch) {
+                short* samples = block.data() + start * nChannels + ch;
+                float* ring = rings[ch].data();
+
+                if (static_cast<size_t>(ch) < lfos.size()) {
+                    lfos[ch].fill(fractions.data(), len);
+                    for (size_t f = 0; f < len; ++f) {
+                        float delay = base + depth * 0.5f * (1.0f + fractions[f]);
+                        offsets[f] = static_cast<int>(delay);
+                        fractions[f] = delay - static_cast<float>(offsets[f]);
+                    }
+                }
+
+                for (size_t f = 0; f < len; ++f)
+                    ring[(pos + f) & mask] = samples[f * nChannels];
+
+                if (interpolation == Interpolation::Cubic)
+                    processSegment<Interpolation::Cubic>(samples, len, ring);
+                else
+                    processSegment<Interpolation::Linear>(samples, len, ring);
+            }
+
+            pos += len;
+        }
+    }
+};
+
+// --- Time-varying delay (flanger / vibrato style) ---
+class DelayModulation : public ModulatedDelay {
+public:
+    DelayModulation(int sampleRate, int nChannels, float maxDelayMs, float freq,
+                    Interpolation interpolation = Interpolation::Cubic)
+        : ModulatedDelay(sampleRate, nChannels, 0.0f, maxDelayMs, freq, 1.0f, 0.7f, interpolation) {}
+};
+
+// --- Chorus: a longer delay mixed with the input, LFOs in quadrature ---
+class Chorus : public ModulatedDelay {
+public:
+    Chorus(int sampleRate, int nChannels, float delayMs, float depthMs, float freq, float mix = 0.5f,
+           Interpolation interpolation = Interpolation::Cubic)
+        : ModulatedDelay(sampleRate, nChannels, delayMs, depthMs, freq, 1.0f, mix, interpolation, M_PI / 2) {}
+};
+
+// --- Vibrato: only the delayed signal (pitch modulation) ---
+class Vibrato : public ModulatedDelay {
+public:
+    Vibrato(int sampleRate, int nChannels, float depthMs, float freq,
+            Interpolation interpolation = Interpolation::Cubic)
+        : ModulatedDelay(sampleRate, nChannels, 0.0f, depthMs, freq, 0.0f, 1.0f, interpolation) {}
+};
+
+// Creates an effect from its name and parameters (as given in the command
+// line); throws std::invalid_argument if they are not valid
+inline std::unique_ptr<Effect> makeEffect(const std::string& name, const std::vector<float>& params,
+                                          int sampleRate, int nChannels) {
+    auto requireParams = [&](size_t n, const char* usage) {
+        if (params.size() < n)
+            throw std::invalid_argument("usage: " + name + " " + usage);
+    };
+
+    if (name == "echo") {
+        requireParams(2, "<delay_ms> <decay>");
+        return std::make_unique<Echo>(sampleRate, nChannels, params[0], params[1]);
+    }
+    if (name == "multiecho") {
+        requireParams(2, "<delay_ms> <decay> [n_echoes]");
+        float nEchoes = params.size() > 2 ? params[2] : 5.0f;
+        if (nEchoes < 0.0f || nEchoes != std::floor(nEchoes))
+            throw std::invalid_argument("multiecho n_echoes must be a whole number (0 = infinite)");
+        // Clamped so the conversion is defined; MultiEcho rejects the long
+        // tails, and beyond 2^62 echoes only a negligible one is left
+        nEchoes = std::min(nEchoes, 4.611686e18f);
+        return std::make_unique<MultiEcho>(sampleRate, nChannels, params[0], params[1], static_cast<size_t>(nEchoes));
+    }
+    if (name == "am") {
+        requireParams(1, "<freq_Hz>");
+        return std::make_unique<AmplitudeModulation>(sampleRate, nChannels, params[0]);
+    }
+    // Optional interpolation order of the modulated delays, after the other parameters
+    auto interpolation = [&](size_t index) {
+        if (params.size() <= index || params[index] == 3.0f)
+            return Interpolation::Cubic;
+        if (params[index] == 1.0f)
+            return Interpolation::Linear;
+        throw std::invalid_argument(name + " interpolation must be 1 (linear) or 3 (cubic)");
+    };
+
+    if (name == "delaymod") {
+        requireParams(2, "<max_delay_ms> <freq_Hz> [interp]");
+        return std::make_unique<DelayModulation>(sampleRate, nChannels, params[0], params[1], interpolation(2));
+    }
+    if (name == "chorus") {
+        requireParams(3, "<delay_ms> <depth_ms> <freq_Hz> [mix] [interp]");
+        return std::make_unique<Chorus>(sampleRate, nChannels, params[0], params[1], params[2],
+                                        params.size() > 3 ? params[3] : 0.5f, interpolation(4));
+    }
+    if (name == "vibrato") {
+        requireParams(2, "<depth_ms> <freq_Hz> [interp]");
+        return std::make_unique<Vibrato>(sampleRate, nChannels, params[0], params[1], interpolation(2));
+    }
+
+    throw std::invalid_argument("unknown effect '" + name + "'");
+}
+
+// Parses an effect chain such as "echo:250:0.5,am:4,delaymod:5:0.5" (stages
+// separated by ',' and parameters by ':')
+inline std::vector<std::unique_ptr<Effect>> makeEffectChain(const std::string& spec, int sampleRate, int nChannels) {
+    std::vector<std::unique_ptr<Effect>> chain;
+    std::istringstream stages(spec);
+    std::string stage;
+
+    while (std::getline(stages, stage, ',')) {
+        std::istringstream fields(stage);
+        std::string name, field;
+        std::getline(fields, name, ':');
+
+        std::vector<float> params;
+        while (std::getline(fields, field, ':')) {
+            try {
+                params.push_back(std::stof(field));
+            } catch (const std::exception&) {
+                throw std::invalid_argument("invalid parameter '" + field + "' in stage '" + stage + "'");
+            }
+        }
+
+        chain.push_back(makeEffect(name, params, sampleRate, nChannels));
+    }
+
+    if (chain.empty())
+        throw std::invalid_argument("empty effect chain");
+
+    return chain;
+}
+
+#endif
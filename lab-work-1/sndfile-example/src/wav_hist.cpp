@@ -15,34 +15,307 @@
 // IEETA / DETI / University of Aveiro
 //
 #include <iostream>
+#include <fstream>
 #include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
 #include <sndfile.hh>
 #include "wav_hist.h"
 
 using namespace std;
+namespace fs = std::filesystem;
 
 constexpr size_t FRAMES_BUFFER_SIZE = 65536; // Buffer for reading frames
 
-int main(int argc, char *argv[]) {
+// Statistics of one file of a batch (one entry per histogram), or the reason
+// why it was skipped
+struct FileResult {
+	string error;
+	vector<HistStats> stats;
+};
 
-	if(argc < 3) {
-		cerr << "Usage: " << argv[0] << " <input file> <channel>\n";
-		return 1;
+// Histograms accumulated by one thread over all its files, one per layout
+struct Totals {
+	WAVHist mono { 1 };
+	WAVHist stereo { 2 };
+	size_t n_mono = 0;
+	size_t n_stereo = 0;
+};
+
+static const char* channel_name(size_t n_hists, size_t c) {
+	static const char* stereo_names[] = { "L", "R", "MID", "SIDE" };
+	return n_hists == 1 ? "0" : stereo_names[c];
+}
+
+// Empty if the file can be processed
+static string check_format(const SndfileHandle& sndFile) {
+	if(sndFile.error())
+		return "invalid input file";
+
+	if((sndFile.format() & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAV)
+		return "file is not in WAV format";
+
+	if((sndFile.format() & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_16)
+		return "file is not in PCM_16 format";
+
+	return "";
+}
+
+static void read_samples(SndfileHandle& sndFile, WAVHist& hist, vector<short>& samples) {
+	size_t nFrames;
+	samples.resize(FRAMES_BUFFER_SIZE * sndFile.channels());
+	while((nFrames = sndFile.readf(samples.data(), FRAMES_BUFFER_SIZE))) {
+		samples.resize(nFrames * sndFile.channels());
+		hist.update(samples);
 	}
+}
 
-	SndfileHandle sndFile { argv[argc-2] };
-	if(sndFile.error()) {
-		cerr << "Error: invalid input file\n";
+static void print_stats(const string& name, const char* channel, const HistStats& s) {
+	cout << name << '\t' << channel << '\t' << s.nSamples << '\t' << s.entropy << '\t'
+		<< s.mean << '\t' << s.variance << '\t' << s.peak << '\n';
+}
+
+static string json_string(const string& text) {
+	string quoted = "\"";
+	for(char c : text) {
+		if(c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+// First-order and conditional entropies of every channel (and MID/SIDE) of a
+// file, from a single pass, as one CSV row per channel or one JSON object
+static int report_entropy(const string& path, const string& format) {
+	SndfileHandle sndFile { path };
+	string error = check_format(sndFile);
+	if(error.empty() && sndFile.channels() > 2)
+		error = "more than 2 channels";
+	if(!error.empty()) {
+		cerr << "Error: " << error << "\n";
 		return 1;
-    }
+	}
+
+	vector<short> samples;
+	WAVHist hist { sndFile, true };
+	read_samples(sndFile, hist, samples);
+
+	if(format == "csv")
+		cout << "file,channel,samples,entropy,conditional_entropy\n";
+	else
+		cout << "{\"file\": " << json_string(path) << ", \"bin_size\": " << (1 << HISTOGRAM_BIN_POWER)
+			<< ", \"context_bits\": " << CONTEXT_BITS << ", \"channels\": [";
+
+	for(size_t c = 0; c < hist.channels(); c++) {
+		HistStats s = hist.stats(c);
+		if(format == "csv")
+			cout << path << ',' << channel_name(hist.channels(), c) << ',' << s.nSamples << ','
+				<< s.entropy << ',' << hist.conditionalEntropy(c) << '\n';
+		else
+			cout << (c ? ", " : "") << "{\"channel\": \"" << channel_name(hist.channels(), c)
+				<< "\", \"samples\": " << s.nSamples << ", \"entropy\": " << s.entropy
+				<< ", \"conditional_entropy\": " << hist.conditionalEntropy(c) << "}";
+	}
+
+	if(format != "csv")
+		cout << "]}\n";
+	return 0;
+}
+
+// The *.wav files of a directory (sorted), or the paths listed in a text file
+// (one per line)
+static vector<string> list_files(const string& arg) {
+	vector<string> files;
+	if(fs::is_directory(arg)) {
+		for(const auto& entry : fs::directory_iterator(arg)) {
+			string ext = entry.path().extension().string();
+			transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			if(entry.is_regular_file() && ext == ".wav")
+				files.push_back(entry.path().string());
+		}
+		sort(files.begin(), files.end());
+	} else {
+		ifstream list { arg };
+		if(!list)
+			throw runtime_error("cannot open " + arg);
+
+		for(string line; getline(list, line); )
+			if(!line.empty())
+				files.push_back(line);
+	}
+	return files;
+}
+
+// Histograms of many files in one process: the files are taken dynamically by
+// n_threads threads, each one accumulating its own WAVHist per layout (no
+// locking), and the per-thread histograms are then reduced into one. Prints
+// the statistics of every file and of the whole set, and the combined
+// histogram of the requested channel; with hist_dir, also writes the
+// histograms of each file there.
+static int batch(const vector<string>& files, size_t channel, unsigned n_threads, const string& hist_dir) {
+	// No more threads than files
+	n_threads = static_cast<unsigned>(max<size_t>(1, min<size_t>(n_threads, files.size())));
+	vector<FileResult> results(files.size());
+	vector<Totals> totals(n_threads);
+	atomic<size_t> next { 0 };
 
-	if((sndFile.format() & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAV) {
-		cerr << "Error: file is not in WAV format\n";
+	auto worker = [&](Totals& total) {
+		vector<short> samples;
+		for(size_t i; (i = next++) < files.size(); ) {
+			SndfileHandle sndFile { files[i] };
+			results[i].error = check_format(sndFile);
+			if(results[i].error.empty() && sndFile.channels() > 2)
+				results[i].error = "more than 2 channels";
+			if(!results[i].error.empty())
+				continue;
+
+			WAVHist hist { sndFile };
+			read_samples(sndFile, hist, samples);
+			for(size_t c = 0; c < hist.channels(); c++)
+				results[i].stats.push_back(hist.stats(c));
+
+			if(!hist_dir.empty()) {
+				ofstream out { fs::path(hist_dir) / (to_string(i) + "_" + fs::path(files[i]).stem().string() + ".txt") };
+				hist.dump(0, out);
+				if(hist.channels() > 1) {
+					out << "\n=== R Channel ===\n";
+					hist.dump(1, out);
+				}
+			}
+
+			if(hist.channels() > 1) {
+				total.stereo.merge(hist);
+				total.n_stereo++;
+			} else {
+				total.mono.merge(hist);
+				total.n_mono++;
+			}
+		}
+	};
+
+	vector<thread> threads;
+	for(unsigned t = 1; t < n_threads; t++)
+		threads.emplace_back(worker, ref(totals[t]));
+	worker(totals[0]);
+	for(auto& thread : threads)
+		thread.join();
+
+	// Reduction of the per-thread histograms
+	Totals& all = totals[0];
+	for(unsigned t = 1; t < n_threads; t++) {
+		all.mono.merge(totals[t].mono);
+		all.stereo.merge(totals[t].stereo);
+		all.n_mono += totals[t].n_mono;
+		all.n_stereo += totals[t].n_stereo;
+	}
+
+	cout << "file\tchannel\tsamples\tentropy\tmean\tvariance\tpeak\n";
+	for(size_t i = 0; i < files.size(); i++) {
+		if(!results[i].error.empty()) {
+			cout << files[i] << "\terror: " << results[i].error << '\n';
+			continue;
+		}
+		for(size_t c = 0; c < results[i].stats.size(); c++)
+			print_stats(files[i], channel_name(results[i].stats.size(), c), results[i].stats[c]);
+	}
+
+	struct Layout { const char* name; const WAVHist& hist; size_t n_files; };
+	const Layout layouts[] = { { "mono", all.mono, all.n_mono }, { "stereo", all.stereo, all.n_stereo } };
+
+	for(const Layout& layout : layouts) {
+		if(layout.n_files == 0)
+			continue;
+
+		string name = to_string(layout.n_files) + " " + layout.name + " files";
+		for(size_t c = 0; c < layout.hist.channels(); c++)
+			print_stats(name, channel_name(layout.hist.channels(), c), layout.hist.stats(c));
+	}
+
+	for(const Layout& layout : layouts) {
+		if(layout.n_files == 0 || channel >= layout.hist.channels())
+			continue;
+
+		cout << "\n=== Combined histogram of the " << layout.name << " files, channel " << channel << " ===\n";
+		layout.hist.dump(channel);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+
+	if(argc >= 2 && string(argv[1]) == "-b") {
+		unsigned n_threads = 1;
+		string hist_dir;
+		int n = 2;
+		for(; n < argc - 2; n += 2) {
+			string opt { argv[n] };
+			if(opt == "-j") {
+				// 0 = all cores; at most 4 threads per core (each one has its
+				// own histograms)
+				string value { argv[n + 1] };
+				size_t used = 0;
+				int j = -1;
+				try {
+					j = stoi(value, &used);
+				} catch(const logic_error&) {
+				}
+				if(j < 0 || used != value.size())
+					break;
+				unsigned n_cores = max(1U, thread::hardware_concurrency());
+				n_threads = j == 0 ? n_cores : min(static_cast<unsigned>(j), 4 * n_cores);
+			} else if(opt == "-d")
+				hist_dir = argv[n + 1];
+			else
+				break;
+		}
+		if(n != argc - 2) {
+			cerr << "Usage: " << argv[0] << " -b [-j threads (0 = all cores, at most 4 per core)] [-d hist_dir] <list file | directory> <channel>\n";
+			return 1;
+		}
+
+		size_t channel = stoi(argv[argc-1]);
+		if(channel > 1) {
+			cerr << "Error: invalid channel requested\n";
+			return 1;
+		}
+
+		try {
+			vector<string> files = list_files(argv[argc-2]);
+			if(!hist_dir.empty())
+				fs::create_directories(hist_dir);
+			return batch(files, channel, n_threads, hist_dir);
+		} catch(const exception& e) {
+			cerr << "Error: " << e.what() << "\n";
+			return 1;
+		}
+	}
+
+	if(argc == 4 && string(argv[1]) == "-e") {
+		string format { argv[2] };
+		if(format != "csv" && format != "json") {
+			cerr << "Error: unknown format (csv or json)\n";
+			return 1;
+		}
+		return report_entropy(argv[3], format);
+	}
+
+	if(argc < 3) {
+		cerr << "Usage: " << argv[0] << " <input file> <channel>\n";
+		cerr << "       " << argv[0] << " -b [-j threads (0 = all cores)] [-d hist_dir] <list file | directory> <channel>\n";
+		cerr << "       " << argv[0] << " -e csv|json <input file> (entropies of all the channels)\n";
 		return 1;
 	}
 
-	if((sndFile.format() & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_16) {
-		cerr << "Error: file is not in PCM_16 format\n";
+	SndfileHandle sndFile { argv[argc-2] };
+	string error = check_format(sndFile);
+	if(!error.empty()) {
+		cerr << "Error: " << error << "\n";
 		return 1;
 	}
 
@@ -52,15 +325,10 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
-	size_t nFrames;
-	vector<short> samples(FRAMES_BUFFER_SIZE * sndFile.channels());
+	vector<short> samples;
 	WAVHist hist { sndFile };
-	while((nFrames = sndFile.readf(samples.data(), FRAMES_BUFFER_SIZE))) {
-		samples.resize(nFrames * sndFile.channels());
-		hist.update(samples);
-	}
+	read_samples(sndFile, hist, samples);
 
 	hist.dump(channel);
 	return 0;
 }
-
@@ -19,81 +19,230 @@
 
 #include <iostream>
 #include <vector>
-#include <map>
+#include <algorithm>
+#include <stdexcept>
 #include <sndfile.hh>
 #include <cmath>
 
 static const size_t HISTOGRAM_BIN_POWER = 0; 
+// The previous sample is reduced to its 2^CONTEXT_BITS most significant values
+// when used as the context of the conditional entropy (a full 2^16 x 2^16
+// table would not fit, and would be too sparse to give a useful estimate)
+static const size_t CONTEXT_BITS = 5;
+
+// Summary of the histogram of one channel; values are taken at the bin centres
+struct HistStats {
+    size_t nSamples = 0;
+    double entropy = 0;  // bits per sample
+    double mean = 0;
+    double variance = 0;
+    int peak = 0;        // largest absolute value
+};
 
 class WAVHist {
 private:
-    std::vector<std::map<int, size_t>> counts; // one map per channel (L, R, MID, SIDE)
+    // Bins covering the whole 16-bit range; bin 0 holds the lowest values
+    static constexpr size_t N_BINS = size_t(65536) >> HISTOGRAM_BIN_POWER;
+    static constexpr int BIN_OFFSET = 32768 >> HISTOGRAM_BIN_POWER;
+
+    static constexpr size_t N_CONTEXTS = size_t(1) << CONTEXT_BITS;
+
+    std::vector<std::vector<size_t>> counts; // one dense array per channel (L, R, MID, SIDE)
+    std::vector<std::vector<size_t>> contextCounts; // N_CONTEXTS arrays of N_BINS per channel, if conditional
+    std::vector<int> previous; // last sample of each channel, the context of the next one
     bool stereo;
     const int binSize; 
 
-    // Proper floor division for negatives
-    int binIndex(short value) const {
-        int q = value / binSize;
-        int r = value % binSize;
-        if ((r != 0) && ((r < 0) != (binSize < 0))) q -= 1;
-        return q;
+    // Floor division by the bin size (a power of two, so an arithmetic shift,
+    // also for negatives), moved to start at 0
+    static size_t binIndex(int value) {
+        return (value >> HISTOGRAM_BIN_POWER) + BIN_OFFSET;
+    }
+
+    static size_t contextIndex(int previousValue) {
+        return static_cast<size_t>(previousValue + 32768) >> (16 - CONTEXT_BITS);
+    }
+
+    // Counts of each value given the context of the previous sample
+    void updateConditional(const std::vector<short>& samples) {
+        size_t nHists = counts.size();
+        size_t nFrames = samples.size() / (stereo ? 2 : 1);
+        int values[4];
+
+        for (size_t i = 0; i < nFrames; ++i) {
+            if (stereo) {
+                int left = samples[i * 2];
+                int right = samples[i * 2 + 1];
+                values[0] = left;
+                values[1] = right;
+                values[2] = (left + right) / 2;
+                values[3] = (left - right) / 2;
+            } else
+                values[0] = samples[i];
+
+            for (size_t c = 0; c < nHists; ++c) {
+                contextCounts[c][contextIndex(previous[c]) * N_BINS + binIndex(values[c])]++;
+                previous[c] = values[c];
+            }
+        }
+    }
+
+    void dumpCounts(const std::vector<size_t>& channelCounts, std::ostream& out) const {
+        size_t nBins = 0;
+        for (size_t count : channelCounts)
+            nBins += count != 0;
+
+        out << "Bin size: " << binSize << "\n";
+        out << "Total bins: " << nBins << "\n\n";
+
+        for (size_t bin = 0; bin < N_BINS; ++bin) {
+            if (channelCounts[bin] == 0)
+                continue;
+
+            // represent bin by its *lower edge* (start of range)
+            int start = (static_cast<int>(bin) - BIN_OFFSET) * binSize;
+            out << start << "\t" << channelCounts[bin] << "\n";
+        }
     }
 
 public:
-    WAVHist(const SndfileHandle& sfh)
-        : stereo(sfh.channels() == 2),
+    // With conditional, also counts each value given the previous one (for
+    // conditionalEntropy(); needs N_CONTEXTS times more memory)
+    explicit WAVHist(int nChannels, bool conditional = false)
+        : stereo(nChannels == 2),
           binSize(1 << HISTOGRAM_BIN_POWER)
     {
-        counts.resize(stereo ? 4 : 1); // mono = 1, stereo = 4 (L, R, MID, SIDE)
+        counts.assign(stereo ? 4 : 1, std::vector<size_t>(N_BINS, 0)); // mono = 1, stereo = 4 (L, R, MID, SIDE)
+        if (conditional) {
+            contextCounts.assign(counts.size(), std::vector<size_t>(N_CONTEXTS * N_BINS, 0));
+            previous.assign(counts.size(), 0);
+        }
+    }
+
+    WAVHist(const SndfileHandle& sfh, bool conditional = false) : WAVHist(sfh.channels(), conditional) {}
+
+    // Number of histograms kept (1 for mono, 4 for stereo)
+    size_t channels() const { return counts.size(); }
+
+    // Adds the counts of another histogram of the same layout (reduction of
+    // the histograms of several files or threads)
+    void merge(const WAVHist& other) {
+        if (other.counts.size() != counts.size())
+            throw std::invalid_argument("cannot merge mono and stereo histograms");
+        if (other.contextCounts.empty() != contextCounts.empty())
+            throw std::invalid_argument("cannot merge histograms with and without conditional counts");
+
+        for (size_t c = 0; c < contextCounts.size(); ++c) {
+            size_t* dst = contextCounts[c].data();
+            const size_t* src = other.contextCounts[c].data();
+            for (size_t bin = 0; bin < N_CONTEXTS * N_BINS; ++bin)
+                dst[bin] += src[bin];
+        }
+
+        for (size_t c = 0; c < counts.size(); ++c) {
+            size_t* dst = counts[c].data();
+            const size_t* src = other.counts[c].data();
+            for (size_t bin = 0; bin < N_BINS; ++bin)
+                dst[bin] += src[bin];
+        }
+    }
+
+    HistStats stats(size_t channel) const {
+        HistStats s;
+        const std::vector<size_t>& channelCounts = counts.at(channel);
+
+        double sum = 0;
+        for (size_t bin = 0; bin < N_BINS; ++bin) {
+            if (channelCounts[bin] == 0)
+                continue;
+
+            int start = (static_cast<int>(bin) - BIN_OFFSET) * binSize;
+            s.nSamples += channelCounts[bin];
+            sum += channelCounts[bin] * (start + (binSize - 1) / 2.0);
+            s.peak = std::max({s.peak, std::abs(start), std::abs(start + binSize - 1)});
+        }
+        if (s.nSamples == 0)
+            return s;
+
+        s.mean = sum / s.nSamples;
+        for (size_t bin = 0; bin < N_BINS; ++bin) {
+            if (channelCounts[bin] == 0)
+                continue;
+
+            double p = static_cast<double>(channelCounts[bin]) / s.nSamples;
+            double deviation = (static_cast<int>(bin) - BIN_OFFSET) * binSize + (binSize - 1) / 2.0 - s.mean;
+            s.entropy -= p * std::log2(p);
+            s.variance += p * deviation * deviation;
+        }
+        return s;
+    }
+
+    // Entropy (bits per sample) of a sample given the previous one of the same
+    // channel, reduced to N_CONTEXTS values: an upper bound of H(X_n | X_n-1)
+    double conditionalEntropy(size_t channel) const {
+        if (contextCounts.empty())
+            throw std::logic_error("histogram built without conditional counts");
+
+        const size_t* joint = contextCounts.at(channel).data();
+        size_t nSamples = 0;
+        double sum = 0; // sum of n(c, x) * log2(n(c, x) / n(c))
+        for (size_t context = 0; context < N_CONTEXTS; ++context, joint += N_BINS) {
+            size_t contextTotal = 0;
+            for (size_t bin = 0; bin < N_BINS; ++bin)
+                contextTotal += joint[bin];
+            if (contextTotal == 0)
+                continue;
+
+            nSamples += contextTotal;
+            for (size_t bin = 0; bin < N_BINS; ++bin)
+                if (joint[bin] != 0)
+                    sum += joint[bin] * std::log2(static_cast<double>(joint[bin]) / contextTotal);
+        }
+        return nSamples == 0 ? 0 : -sum / nSamples;
     }
 
+    // Branch-free: a counter increment per channel and frame, with no lookups
     void update(const std::vector<short>& samples) {
-        size_t nChannels = stereo ? 2 : 1;
-        size_t nFrames = samples.size() / nChannels;
+        if (!contextCounts.empty())
+            updateConditional(samples);
 
-        for (size_t i = 0; i < nFrames; ++i) {
-            short left = samples[i * nChannels];
-            counts[0][binIndex(left)]++;
+        if (!stereo) {
+            size_t* mono = counts[0].data();
+            for (short sample : samples)
+                mono[binIndex(sample)]++;
+            return;
+        }
 
-            if (stereo) {
-                short right = samples[i * nChannels + 1];
-                counts[1][binIndex(right)]++;
+        size_t* leftCounts = counts[0].data();
+        size_t* rightCounts = counts[1].data();
+        size_t* midCounts = counts[2].data();
+        size_t* sideCounts = counts[3].data();
+        size_t nFrames = samples.size() / 2;
 
-                short mid  = (left + right) / 2;
-                short side = (left - right) / 2;
-                counts[2][binIndex(mid)]++;
-                counts[3][binIndex(side)]++;
-            }
+        for (size_t i = 0; i < nFrames; ++i) {
+            int left = samples[i * 2];
+            int right = samples[i * 2 + 1];
+            leftCounts[binIndex(left)]++;
+            rightCounts[binIndex(right)]++;
+            midCounts[binIndex((left + right) / 2)]++;
+            sideCounts[binIndex((left - right) / 2)]++;
         }
     }
 
-    void dump(const size_t channel) const {
+    void dump(const size_t channel, std::ostream& out = std::cout) const {
         if (channel >= counts.size()) {
             std::cerr << "Error: invalid channel requested\n";
             return;
         }
 
-        std::cout << "Bin size: " << binSize << "\n";
-        std::cout << "Total bins: " << counts[channel].size() << "\n\n";
-
-        for (auto [bin, count] : counts[channel]) {
-            // represent bin by its *lower edge* (start of range)
-            int start = bin * binSize;
-            std::cout << start << "\t" << count << "\n";
-        }
+        dumpCounts(counts[channel], out);
 
         // print MID/SIDE automatically after channel 1 (if stereo)
         if (stereo && channel == 1) {
             const char* labels[] = {"MID", "SIDE"};
             for (size_t c = 2; c < 4; ++c) {
-                std::cout << "\n=== " << labels[c - 2] << " Channel ===\n";
-                std::cout << "Bin size: " << binSize << "\n";
-                std::cout << "Total bins: " << counts[c].size() << "\n\n";
-
-                for (auto [bin, count] : counts[c]) {
-                    int start = bin * binSize;
-                    std::cout << start << "\t" << count << "\n";
-                }
+                out << "\n=== " << labels[c - 2] << " Channel ===\n";
+                dumpCounts(counts[c], out);
             }
         }
     }
@@ -2,20 +2,36 @@
 #include <vector>
 #include <sndfile.hh>
 #include <cmath>
+#include "uniform_quant.h"
 
 using namespace std;
 
 constexpr size_t FRAMES_BUFFER_SIZE = 65536; // buffer frames
 
 int main(int argc, char* argv[]) {
-    if(argc < 4) {
-        cerr << "Usage: wav_quant <input.wav> <output.wav> <bits>\n";
+    QuantMode mode = QuantMode::MidRise;
+    bool dither = false;
+    int n = 1;
+    for(; n < argc && argv[n][0] == '-'; ++n) {
+        if(string(argv[n]) == "-tread")
+            mode = QuantMode::MidTread;
+        else if(string(argv[n]) == "-dither")
+            dither = true;
+        else
+            break;
+    }
+
+    if(argc - n != 3) {
+        cerr << "Usage: wav_quant [-tread] [-dither] <input.wav> <output.wav> <bits>\n";
+        cerr << "  -tread: mid-tread quantizer (levels at multiples of the step, including 0)\n";
+        cerr << "          instead of mid-rise (levels at the centres of the intervals)\n";
+        cerr << "  -dither: add triangular noise of up to one step before quantizing\n";
         return 1;
     }
 
-    string inFile  = argv[1];
-    string outFile = argv[2];
-    int bits = stoi(argv[3]);
+    string inFile  = argv[n];
+    string outFile = argv[n + 1];
+    int bits = stoi(argv[n + 2]);
 
     if(bits <= 0 || bits > 16) {
         cerr << "Error: bits must be between 1 and 16\n";
@@ -34,21 +50,12 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // Quantization parameters
-    int nLevels = 1 << bits;
-    int step = 65536 / nLevels; // step size
+    UniformQuantizer quantizer { bits, mode, dither };
     vector<short> samples(FRAMES_BUFFER_SIZE * sfhIn.channels());
 
     size_t nFrames;
     while((nFrames = sfhIn.readf(samples.data(), FRAMES_BUFFER_SIZE))) {
-        for(size_t i = 0; i < nFrames * sfhIn.channels(); ++i) {
-            int s = samples[i] + 32768;         // shift to [0,65535]
-            s = (s / step) * step + step/2;     // quantize
-            s -= 32768;                         // shift back
-            if(s > 32767) s = 32767;            // clamp
-            if(s < -32768) s = -32768;
-            samples[i] = static_cast<short>(s);
-        }
+        quantizer.quantize(samples.data(), nFrames * sfhIn.channels());
         sfhOut.writef(samples.data(), nFrames);
     }
 